@@ -0,0 +1,147 @@
+#include "bytemachine.h"
+#include <cctype>
+
+// Returns the bytes the given C++ string literal contents stand for
+string ByteMachine::unescape(string literal) {
+	// Simple escapes and the bytes they stand for
+	static const map<char, char> ESCAPES = {
+		{ 'n', '\n' }, { 't', '\t' }, { 'r', '\r' }, { 'a', '\a' }, { 'b', '\b' },
+		{ 'f', '\f' }, { 'v', '\v' }, { '\\', '\\' }, { '"', '"' }, { '\'', '\'' }, { '?', '?' }
+	};
+
+	string bytes;
+
+	for (size_t i = 0; i < literal.size(); ++i) {
+		// Anything other than an escape is taken as is
+		if (literal[i] != '\\' || i + 1 == literal.size()) {
+			bytes += literal[i];
+			continue;
+		}
+
+		char escape = literal[++i];
+
+		// Hex escapes take every hex digit that follows
+		if (escape == 'x') {
+			int value = 0;
+			while (i + 1 < literal.size() && isxdigit(literal[i + 1])) value = value * 16 + stoi(literal.substr(++i, 1), nullptr, 16);
+			bytes += (char)value;
+
+		// Octal escapes take up to three octal digits
+		} else if (escape >= '0' && escape <= '7') {
+			int value = escape - '0';
+			for (int digits = 1; digits < 3 && i + 1 < literal.size() && literal[i + 1] >= '0' && literal[i + 1] <= '7'; ++digits)
+				value = value * 8 + (literal[++i] - '0');
+			bytes += (char)value;
+		} else if (ESCAPES.count(escape)) {
+			bytes += ESCAPES.at(escape);
+		} else {
+			bytes += escape;
+		}
+	}
+
+	return bytes;
+}
+
+// Builds the trie of match strings and completes its transitions with Aho-Corasick failure links
+void ByteMachine::buildTrie() {
+	trie.assign(1, vector<int>(ALPHABET_SIZE, -1));
+	output.assign(1, -1);
+
+	// Insert each match string
+	for (size_t i = 0; i < matches.size(); ++i) {
+		int node = 0;
+
+		for (unsigned char c : unescape(matches[i])) {
+			if (trie[node][c] < 0) {
+				trie[node][c] = trie.size();
+				trie.push_back(vector<int>(ALPHABET_SIZE, -1));
+				output.push_back(-1);
+			}
+			node = trie[node][c];
+		}
+
+		output[node] = i;
+	}
+
+	// Failure link of each node; the longest proper suffix that is also in the trie
+	vector<int> fail(trie.size(), 0);
+
+	// Nodes in breadth-first order so failure links are set before they are followed
+	vector<int> queue;
+
+	for (int c = 0; c < ALPHABET_SIZE; ++c) {
+		if (trie[0][c] < 0) {
+			trie[0][c] = 0;
+		} else {
+			fail[trie[0][c]] = 0;
+			queue.push_back(trie[0][c]);
+		}
+	}
+
+	for (size_t i = 0; i < queue.size(); ++i) {
+		int node = queue[i];
+
+		// Nodes that do not end an input report the longest input ending at their failure link
+		if (output[node] < 0) output[node] = output[fail[node]];
+
+		for (int c = 0; c < ALPHABET_SIZE; ++c) {
+			int child = trie[node][c];
+
+			if (child < 0) {
+				trie[node][c] = trie[fail[node]][c];
+			} else {
+				fail[child] = trie[fail[node]][c];
+				queue.push_back(child);
+			}
+		}
+	}
+}
+
+// Builds the product of the trie over the given match strings and a DFA. targets maps each DFA state and match
+// string to the state it moves to. Product states that reach the given end state are not expanded
+void ByteMachine::build(vector<string> m, map<string, map<string, string>> &targets, string first, string end) {
+	matches = m;
+	buildTrie();
+
+	next.clear();
+	match.clear();
+	machineStates.clear();
+
+	// Maps (trie node, DFA state) pairs to product state indexes
+	map<pair<int, string>, int> index;
+
+	// Product states in discovery order; the start state is 0
+	vector<pair<int, string>> products;
+
+	products.push_back(make_pair(0, first));
+	index[products[0]] = 0;
+	match.push_back(-1);
+
+	for (size_t i = 0; i < products.size(); ++i) {
+		int node = products[i].first;
+		string state = products[i].second;
+
+		machineStates.push_back(state);
+		next.push_back(vector<int>(ALPHABET_SIZE, i));
+
+		// END has no transitions
+		if (state == end) continue;
+
+		for (int c = 0; c < ALPHABET_SIZE; ++c) {
+			int nextNode = trie[node][c];
+			int matched = output[nextNode];
+
+			// A completed match moves the DFA; other bytes only move through the trie
+			string nextState = matched < 0 ? state : targets[state][matches[matched]];
+
+			pair<int, string> product = make_pair(nextNode, nextState);
+			if (!index.count(product)) {
+				index[product] = products.size();
+				products.push_back(product);
+				match.push_back(matched);
+			}
+
+			next[i][c] = index[product];
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef BYTE_MACHINE_H
+#define BYTE_MACHINE_H
+
+#define ALPHABET_SIZE 256			// Number of distinct bytes
+#define ALPHABET_SIZE_STRING "256"	// Number of distinct bytes, for writing into compiled code
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// Class that merges input strings into an Aho-Corasick automaton and composes it with a DFA, giving one
+// machine over raw bytes. Each product state pairs a trie node with a state of the DFA
+class ByteMachine {
+private:
+	vector<vector<int>> trie;	// Trie transitions completed with failure links: node -> (byte -> node)
+	vector<int> output;			// Index of the longest input ending at each trie node, or -1
+
+	void buildTrie();
+
+public:
+	vector<string> matches;			// Input strings the machine matches, as written in source
+	vector<vector<int>> next;		// Product transitions: product state -> (byte -> product state)
+	vector<int> match;				// Index of the input matched on entering each product state, or -1
+	vector<string> machineStates;	// DFA state of each product state
+
+	ByteMachine(){}
+	~ByteMachine(){}
+
+	static string unescape(string);
+
+	void build(vector<string>, map<string, map<string, string>>&, string, string);
+};
+
+#endif
@@ -1,7 +1,7 @@
 #include "compiler.h"
 
-// Takes strings of source file path
-Compiler::Compiler(string p) {
+// Takes strings of source file path and command line options
+Compiler::Compiler(string p, Options o) : Compiler(o, 1) {
 	// Initialization
 	src.open(p);
 
@@ -9,18 +9,27 @@ Compiler::Compiler(string p) {
 	if (!src) Error::sourceOpenError(p);
 
 	compiledName = p.substr(0, p.find_last_of(".")) + ".cpp";
-	lineCount = 1;
+	summaryFormat = SUMMARY_TEXT;
+}
+
+// Takes command line options and the line parsing starts at. Used on its own to parse chunks of a source on other
+// threads; a chunk's summary format stays empty unless the chunk declares one
+Compiler::Compiler(Options o, int firstLine) {
+	options = o;
+	lineCount = firstLine;
 	attatchAction = false;
-	inputActionParsed = false;
 
 	// Create regex objects for searching
 	fileRegex = regex(FILE_TYPE GENERAL_ACTION);
 	inputRegex = regex(INPUT_TYPE GENERAL_ACTION);
 	stateRegex = regex(STATE_TYPE STATE_VALUE);
+	classRegex = regex(CLASS_TYPE STATE_VALUE);
 	scanRegex = regex(SCAN CONSOLE_ACTION);
 	readRegex = regex(READ GENERAL_ACTION);
 	writeRegex = regex(WRITE GENERAL_ACTION);
 	printRegex = regex(PRINT CONSOLE_ACTION);
+	countRegex = regex(COUNT COUNT_ACTION);
+	summaryRegex = regex(SUMMARY CONSOLE_ACTION);
 }
 
 // Closes source
@@ -76,22 +85,68 @@ void Compiler::split(string str, char delim, vector<string> &vect) {
 
 // Returns true if the given identifier is valid
 bool Compiler::isValidIdentifier(string id) {
+	// Compiled once and shared by every parsing thread
+	static const regex validIdentifier(VALID_IDENTIFIER);
+
 	// Check if id is valid and doesn't clash with certain reserved words
-	if (regex_match(id, regex(VALID_IDENTIFIER)) &&
+	if (regex_match(id, validIdentifier) &&
 		id != IN &&
+		id != SRC &&
 		id != STATE &&
 		id != INPUT_TYPE &&
 		id != STATE_TYPE &&
 		id != FILE_TYPE &&
+		id != CLASS_TYPE &&
 		id != PRINT &&
 		id != WRITE &&
 		id != SCAN &&
-		id != READ) {
+		id != READ &&
+		id != EPSILON &&
+		id != COUNT &&
+		id != SUMMARY) {
 		return true;
 	}
 	return false;
 }
 
+// Returns true if parsing the given line would read it as a state definition
+bool Compiler::isStateLine(string line) {
+	string trimmedLine = trim(line);
+
+	return trimmedLine.rfind(COMMENT, 0) == string::npos &&
+		trimmedLine.rfind(CLASS_TYPE, 0) == string::npos &&
+		line.find(INPUT_TYPE) == string::npos &&
+		line.find(FILE_TYPE) == string::npos &&
+		line.find(STATE_TYPE) != string::npos;
+}
+
+// Runs the given task on the given number of threads, passing each its index, and waits for them to finish. Errors
+// raised on the threads are deferred; the message of each thread's error is put in errors, or left empty
+void Compiler::runParallel(int count, function<void(int)> task, vector<string> &errors) {
+	errors.assign(count, "");
+
+	vector<thread> threads;
+	for (int i = 0; i < count; ++i) {
+		threads.emplace_back([&task, &errors, i]() {
+			Error::deferred = true;
+
+			try {
+				task(i);
+			} catch (Error::DeferredError &e) {
+				errors[i] = e.message;
+			}
+		});
+	}
+
+	for (thread &t : threads) t.join();
+}
+
+// Returns number of threads to split the given amount of lines or states between. Each thread gets at least
+// PARALLEL_GRAIN of them, so work is only split once there is twice that much
+int Compiler::workers(size_t work) {
+	return max(1, min(options.jobs, (int)(work / PARALLEL_GRAIN)));
+}
+
 // Takes the given string representing a delimiter and returns the first char delimiter it parses from it as a string
 string Compiler::strDelimToChar(string delim) {
 	string trimmedDelim = trim(delim);
@@ -145,6 +200,9 @@ void Compiler::parseInputAndFileDeclarations(string line) {
 	// Check that action id is a valid identifier
 	if (!isValidIdentifier(actionIdentifier)) Error::invalidIdentifier(lineCount, actionIdentifier);
 
+	// Standard input is named after SCAN_SOURCE wherever sources are told apart, so no file may share its name
+	if (targetMap == &files && actionIdentifier == SCAN_SOURCE) Error::reservedSourceName(lineCount, actionIdentifier);
+
 	// Adds parsed data to target map
 	targetMap->operator[](actionIdentifier) = actionArg;
 }
@@ -173,11 +231,12 @@ void Compiler::parseState(string line) {
 
 	string rawTransitionMap = matches.str(2);
 
-	// If the transition map is blank, put a blank string mapping in the states map to indicate sink state
-	if (rawTransitionMap.empty()) {
-		map<string, string> blank;
-		blank[""] = "";
-		states[stateName] = blank;
+	// Maps input names to target state names; represents transitions
+	map<string, set<string>> transitionMap;
+
+	// If the transition map is blank, this is a sink state with no transitions
+	if (trim(rawTransitionMap).empty()) {
+		nfa.transitions[stateName] = transitionMap;
 		return;
 	}
 
@@ -187,35 +246,62 @@ void Compiler::parseState(string line) {
 	// Split transition map at commas
 	split(rawTransitionMap, TRANSITION_SEPARATOR, transitionMapSplit);
 
-	// Maps input names to state names; represents transitions
-	map<string, string> transitionMap;
-
 	// Current transition being parsed in loop
 	vector<string> transition;
 
+	// Targets of current transition
+	vector<string> targets;
+
 	// Parse transition mappings from raw transition map
 	for (int i = 0; i < transitionMapSplit.size(); ++i) {
 		// Parse transition and add it to the map
 		split(transitionMapSplit[i], MAPPING_SEPARATOR, transition);
 
-		// Don't add this transition if it transitions to current state
-		if (stateName == trim(transition[1])) continue;
+		if (transition.size() != 2) Error::malformedAction(lineCount);
+
+		// Split alternative targets of a nondeterministic transition
+		split(transition[1], TARGET_SEPARATOR, targets);
+
+		// Repeated inputs add targets instead of replacing them
+		for (string target : targets) transitionMap[trim(transition[0])].insert(trim(target));
+	}
+
+	// Add this state and its corresponding transitions to the machine
+	nfa.transitions[stateName] = transitionMap;
+}
+
+// Parses input class declaration from given line
+void Compiler::parseClass(string line) {
+	// Will hold regex matches
+	smatch matches;
+
+	// Search line with regex
+	if (!regex_search(line, matches, classRegex)) Error::malformedAction(lineCount);
+
+	string className = trim(matches.str(1));
+
+	// Check that class name is a valid identifier
+	if (!isValidIdentifier(className)) Error::invalidIdentifier(lineCount, className);
+
+	// Split member list at commas
+	vector<string> members;
+	split(matches.str(2), CLASS_SEPARATOR, members);
 
-		// Add transition to map if it hasn't already been added
-		transitionMap[trim(transition[0])] = trim(transition[1]);
+	// Trimmed input names in this class
+	vector<string> classInputs;
+	for (string member : members) {
+		string input = trim(member);
+		if (input.empty()) Error::malformedAction(lineCount);
+		classInputs.push_back(input);
 	}
 
-	// Add this state and its corresponding transitions to the states map
-	states[stateName] = transitionMap;
+	classes[className] = classInputs;
 }
 
 // Parsed input actions such as SCAN and READ
 void Compiler::parseInputAction(string line) {
 	string trimmedLine = trim(line);
 
-	// Check for duplicate input actions
-	if (inputActionParsed) Error::multipleInputActions(lineCount);
-
 	// Action that will contain parsed input action data
 	Action action;
 
@@ -227,8 +313,8 @@ void Compiler::parseInputAction(string line) {
 		// Search line with regex. Throws error if it does not match
 		if (!regex_search(trimmedLine, scanParts, scanRegex)) Error::malformedAction(lineCount);
 
-		// Create action container for SCAN action being parsed
-		action = Action(SCAN, strDelimToChar(scanParts.str(1)));
+		// Create action container for SCAN action being parsed; its source is standard input
+		action = Action(SCAN, SCAN_SOURCE, strDelimToChar(scanParts.str(1)));
 
 	// If the action is a READ statement
 	} else if (trimmedLine.rfind(READ, 0) != string::npos) {
@@ -243,8 +329,13 @@ void Compiler::parseInputAction(string line) {
 	// If this statement is not a valid input action
 	}
 
-	inputAction = action;
-	inputActionParsed = true;
+	// Each source may only be read once, since its tokens can only be split one way
+	for (Action other : inputActions) {
+		if (other.identifier == action.identifier) Error::duplicateInputSource(lineCount, action.identifier);
+	}
+
+	inputActions.push_back(action);
+	inputActionLines.push_back(lineCount);
 }
 
 // Parses built-in output actions
@@ -256,7 +347,8 @@ void Compiler::parseOutputAction(string line) {
 
 	// Throw error if line does not start with any built-in output actions
 	if (trimmedLine.rfind(PRINT, 0) == string::npos &&
-		trimmedLine.rfind(WRITE, 0) == string::npos) {
+		trimmedLine.rfind(WRITE, 0) == string::npos &&
+		trimmedLine.rfind(COUNT, 0) == string::npos) {
 		Error::unknownOutputAction(lineCount);
 	}
 
@@ -284,6 +376,21 @@ void Compiler::parseOutputAction(string line) {
 
 		// Create action container for PRINT action being parsed
 		action = Action(WRITE, writeParts.str(1), writeParts.str(2));
+
+	// If this action is a COUNT statement
+	} else if (trimmedLine.rfind(COUNT, 0) != string::npos) {
+		// Holds parsed parts of COUNT statement
+		smatch countParts;
+
+		// Search line with regex. Throws error if it does not match
+		if (!regex_match(trimmedLine, countParts, countRegex)) Error::malformedAction(lineCount);
+
+		// The only optional argument is a histogram of IN values
+		string countArg = countParts.str(2);
+		if (countParts[1].matched && countArg != IN_MARKER) Error::malformedAction(lineCount);
+
+		// Create action container for COUNT action; identifier holds the counted state
+		action = Action(COUNT, mostRecentState, countArg);
 	
 	// If this statement is not a valid output action
 	} else  {
@@ -294,9 +401,40 @@ void Compiler::parseOutputAction(string line) {
 	outputActions[mostRecentState].push_back(action);
 }
 
+// Parses machine-level SUMMARY declaration selecting how COUNT totals are emitted
+void Compiler::parseSummary(string line) {
+	string trimmedLine = trim(line);
+
+	// Holds parsed parts of SUMMARY declaration
+	smatch summaryParts;
+
+	// Search line with regex. Throws error if it does not match
+	if (!regex_search(trimmedLine, summaryParts, summaryRegex)) Error::malformedAction(lineCount);
+
+	string format = trim(summaryParts.str(1));
+
+	// Only text and JSON summaries are supported
+	if (format != SUMMARY_TEXT && format != SUMMARY_JSON) Error::invalidSummaryFormat(lineCount, format);
+
+	summaryFormat = format;
+}
+
 // Compile parsed data to a compiled file
 void Compiler::compile() {
-	Writer w(compiledName, &files, &inputs, &states, &outputActions, &inputAction, firstState);
+	// Profiles record visits to DFA states in delimiter-split machines
+	if (options.profileGen && (nfa.lazy || options.byteLevel)) Error::profileUnsupported();
+
+	// Corpus tokens are whole delimited tokens, which byte-level machines do not have
+	if (options.corpusInput && options.byteLevel) Error::corpusUnsupported();
+
+	// Tables hold a complete DFA stepped on delimited inputs
+	if (options.tableDriven && (nfa.lazy || options.byteLevel || options.corpusInput || options.asyncOutput || options.profileGen))
+		Error::tablesUnsupported();
+
+	// Reading several sources needs the delimiter-split event loop
+	if (inputActions.size() > 1 && (options.byteLevel || options.corpusInput || options.tableDriven)) Error::multiplexUnsupported();
+
+	Writer w(compiledName, &files, &inputs, &states, &outputActions, &inputActions, firstState, summaryFormat, &nfa, &options);
 	w.write();
 }
 
@@ -305,14 +443,16 @@ void Compiler::checkForParseErrors() {
 	// Check if any required data is not included
 	if (inputs.size() == 0) Error::noInputs();
 
-	if (states.size() == 0) Error::noStates();
+	if (nfa.transitions.size() == 0) Error::noStates();
 
 	// Check if there is no input action
-	if (inputAction.name.empty()) Error::noInputActions();
+	if (inputActions.empty()) Error::noInputActions();
 
-	// If input action is WRITE and the file name hasn't been declared, throw error
-	if (inputAction.name == READ && !files.count(inputAction.identifier))
-		Error::referencingUndeclaredFile(inputAction.identifier);
+	// If an input action is READ and the file name hasn't been declared, throw error
+	for (Action a : inputActions) {
+		if (a.name == READ && !files.count(a.identifier))
+			Error::referencingUndeclaredFile(a.identifier);
+	}
 
 	// Check WRITE actions to make sure they reference valid files
 	for (pair<string, vector<Action>> outputAction : outputActions) {
@@ -324,19 +464,185 @@ void Compiler::checkForParseErrors() {
 		}
 	}
 
-	// Check that all inputs and states referenced in transitions were declared
-	for (pair<string, map<string, string>> state : states) {
+	// Check that classes only contain declared inputs and do not shadow them
+	for (pair<string, vector<string>> inputClass : classes) {
+		if (inputs.count(inputClass.first)) Error::classInputClash(inputClass.first);
+
+		for (string input : inputClass.second) {
+			if (!inputs.count(input)) Error::referencingUndeclaredInput(input);
+		}
+	}
+
+	// States in name order, so they can be split between threads
+	vector<const pair<const string, map<string, set<string>>>*> stateList;
+	for (const pair<const string, map<string, set<string>>> &state : nfa.transitions) stateList.push_back(&state);
+
+	int count = workers(stateList.size());
+	if (count == 1) {
+		checkTransitions(stateList, 0, stateList.size());
+		return;
+	}
+
+	// Each thread stops at the first error in its range, so the error of the first thread with one is the error a
+	// serial check would have found
+	vector<string> errors;
+	runParallel(count, [&](int i) {
+		checkTransitions(stateList, stateList.size() * i / count, stateList.size() * (i + 1) / count);
+	}, errors);
+
+	for (string error : errors) {
+		if (!error.empty()) Error::reportDeferred(error);
+	}
+}
+
+// Checks that all inputs and states referenced in transitions of the given range of states were declared
+void Compiler::checkTransitions(vector<const pair<const string, map<string, set<string>>>*> &stateList, size_t begin, size_t end) {
+	for (size_t i = begin; i < end; ++i) {
 		// Iterate through each transition
-		for (pair<string, string> trans : state.second) {
+		for (const pair<const string, set<string>> &trans : stateList[i]->second) {
 			// If transition input does not exist in inputs, throw error
-			if (!trans.first.empty() && !inputs.count(trans.first))
+			if (trans.first != EPSILON && trans.first != DEFAULT_INPUT && !inputs.count(trans.first) && !classes.count(trans.first))
 				Error::referencingUndeclaredInput(trans.first);
 
 			// If transition target state does not exist in states, throw error
-			if (!trans.second.empty() &&!states.count(trans.second))
-				Error::referencingUndeclaredState(trans.second);
+			for (const string &target : trans.second) {
+				if (target != END_STATE && !nfa.transitions.count(target))
+					Error::referencingUndeclaredState(target);
+			}
+		}
+	}
+}
+
+// Builds the deterministic states the writer compiles, running subset construction if the machine is nondeterministic
+void Compiler::buildStates() {
+	// Transitions on classes apply to every input in them
+	nfa.expandClasses(classes);
+
+	if (nfa.isDeterministic()) {
+		nfa.toDfa(states);
+		return;
+	}
+
+	// Name of the DFA state containing the first state
+	string start = firstState;
+
+	// Fall back on building DFA states at runtime if the full DFA is too large
+	if (nfa.determinize(start, options.dfaLimit, states, outputActions)) {
+		firstState = start;
+	} else {
+		states.clear();
+		nfa.lazy = true;
+
+		// Byte-level machines are composed with a complete DFA at compile time
+		if (options.byteLevel) Error::byteLevelDfaTooLarge(options.dfaLimit);
+	}
+}
+
+// Parses a single line of source
+void Compiler::parseLine(string line) {
+	// Check if current line has an opening block character
+	if (line.find(BLOCK_START) != string::npos) {
+		// Throw error if user is trying to open a block without closing the last
+		if (attatchAction) Error::missingClosingBrace(lineCount);
+
+		// Set attach action to true if this is a valid block start
+		else attatchAction = true;
+	}	
+
+	// Check what the line is doing. Call appropriate function to parse it
+	if (trim(line).rfind(COMMENT, 0) != string::npos);
+	else if (trim(line).rfind(CLASS_TYPE, 0) != string::npos) parseClass(line);
+	else if (line.find(INPUT_TYPE) != string::npos || line.find(FILE_TYPE) != string::npos) parseInputAndFileDeclarations(line);
+	else if (line.find(STATE_TYPE) != string::npos) parseState(line);
+	else if (line.find(SCAN) != string::npos || line.find(READ) != string::npos) parseInputAction(line);
+	else if (!attatchAction && trim(line).rfind(SUMMARY, 0) != string::npos) parseSummary(line);
+	else if (attatchAction) parseOutputAction(line);
+	else {
+		if (trim(line) != "") Error::unknownStatement(lineCount, line);
+	}
+
+	// Check if current line has a closing block character
+	if (line.find(BLOCK_END) != string::npos) {
+		// Throw error if user is trying to close a block without closing the last
+		if (!attatchAction) Error::missingOpeningBrace(lineCount);
+
+		// Set attach action to false if this is a valid block end
+		else attatchAction = false;
+	}
+}
+
+// Picks the first line of each chunk. Chunks are about the same size and only start at state definitions outside
+// a block, where parsing carries nothing over from earlier lines that cannot be merged afterwards
+void Compiler::chunkBoundaries(vector<string> &lines, size_t count, vector<size_t> &starts) {
+	starts.assign(1, 0);
+
+	// Whether a block is open before the current line, tracked the same way parseLine tracks it
+	bool inBlock = false;
+
+	for (size_t i = 0; i < lines.size() && starts.size() < count; ++i) {
+		if (!inBlock && i >= lines.size() * starts.size() / count && isStateLine(lines[i])) starts.push_back(i);
+
+		if (lines[i].find(BLOCK_START) != string::npos) inBlock = true;
+		if (lines[i].find(BLOCK_END) != string::npos) inBlock = false;
+	}
+}
+
+// Parses the given lines in chunks on the given number of threads and merges the chunks in source order. Errors
+// are reported for the earliest line they occur on, as if the lines had been parsed one at a time
+void Compiler::parseChunks(vector<string> &lines, int count) {
+	vector<size_t> starts;
+	chunkBoundaries(lines, count, starts);
+	starts.push_back(lines.size());
+
+	// Each chunk is parsed by its own parser starting at the chunk's first line
+	vector<unique_ptr<Compiler>> chunks;
+	for (size_t i = 0; i + 1 < starts.size(); ++i) chunks.emplace_back(new Compiler(options, starts[i] + 1));
+
+	vector<string> errors;
+	runParallel(chunks.size(), [&](int i) {
+		for (size_t line = starts[i]; line < starts[i + 1]; ++line) {
+			chunks[i]->parseLine(lines[line]);
+			++chunks[i]->lineCount;
+		}
+	}, errors);
+
+	for (size_t i = 0; i < chunks.size(); ++i) mergeChunk(*chunks[i], errors[i]);
+
+	lineCount = lines.size() + 1;
+}
+
+// Merges a chunk parsed on another thread into this parser as if its lines had been parsed here, then reports the
+// given error the chunk stopped at, if any
+void Compiler::mergeChunk(Compiler &chunk, string error) {
+	// Sources read by earlier chunks were not known to the chunk
+	for (size_t i = 0; i < chunk.inputActions.size(); ++i) {
+		for (Action other : inputActions) {
+			if (other.identifier == chunk.inputActions[i].identifier)
+				Error::duplicateInputSource(chunk.inputActionLines[i], other.identifier);
 		}
+
+		inputActions.push_back(chunk.inputActions[i]);
+		inputActionLines.push_back(chunk.inputActionLines[i]);
 	}
+
+	// Everything the chunk parsed came before its error
+	if (!error.empty()) Error::reportDeferred(error);
+
+	// Later declarations replace earlier ones
+	for (pair<const string, string> &file : chunk.files) files[file.first] = file.second;
+	for (pair<const string, string> &input : chunk.inputs) inputs[input.first] = input.second;
+	for (pair<const string, vector<string>> &inputClass : chunk.classes) classes[inputClass.first] = move(inputClass.second);
+	for (pair<const string, map<string, set<string>>> &state : chunk.nfa.transitions) nfa.transitions[state.first] = move(state.second);
+
+	// Actions of a state accumulate in source order
+	for (pair<const string, vector<Action>> &stateActions : chunk.outputActions) {
+		vector<Action> &actions = outputActions[stateActions.first];
+		actions.insert(actions.end(), stateActions.second.begin(), stateActions.second.end());
+	}
+
+	if (firstState.empty()) firstState = chunk.firstState;
+	if (!chunk.summaryFormat.empty()) summaryFormat = chunk.summaryFormat;
+	mostRecentState = chunk.mostRecentState;
 }
 
 // Parses source files
@@ -344,37 +650,23 @@ void Compiler::parse() {
 	// Current line in source
 	string line;
 
-	// Iterate through lines in source
-	while (getline(src, line)) {
-		// Check if current line has an opening block character
-		if (line.find(BLOCK_START) != string::npos) {
-			// Throw error if user is trying to open a block without closing the last
-			if (attatchAction) Error::missingClosingBrace(lineCount);
-
-			// Set attach action to true if this is a valid block start
-			else attatchAction = true;
-		}	
-
-		// Check what the line is doing. Call appropriate function to parse it
-		if (trim(line).rfind(COMMENT, 0) != string::npos);
-		else if (line.find(INPUT_TYPE) != string::npos || line.find(FILE_TYPE) != string::npos) parseInputAndFileDeclarations(line);
-		else if (line.find(STATE_TYPE) != string::npos) parseState(line);
-		else if (line.find(SCAN) != string::npos || line.find(READ) != string::npos) parseInputAction(line);
-		else if (attatchAction) parseOutputAction(line);
-		else {
-			if (trim(line) != "") Error::unknownStatement(lineCount, line);
-		}
+	// Lines of source, kept so large sources can be split into chunks
+	vector<string> lines;
+	while (getline(src, line)) lines.push_back(line);
 
-		// Check if current line has a closing block character
-		if (line.find(BLOCK_END) != string::npos) {
-			// Throw error if user is trying to close a block without closing the last
-			if (!attatchAction) Error::missingOpeningBrace(lineCount);
+	// Large sources are parsed on several threads
+	int chunks = workers(lines.size());
 
-			// Set attach action to false if this is a valid block end
-			else attatchAction = false;
+	if (chunks > 1) {
+		parseChunks(lines, chunks);
+	} else {
+		// Iterate through lines in source
+		for (string &sourceLine : lines) {
+			parseLine(sourceLine);
+			++lineCount;
 		}
-
-		++lineCount;
 	}
+
 	checkForParseErrors();
+	buildStates();
 }
\ No newline at end of file
@@ -5,32 +5,52 @@
 #define INPUT_TYPE "INPUT"
 #define STATE_TYPE "STATE"
 #define FILE_TYPE "FILE"
+#define CLASS_TYPE "CLASS"
 #define TRANSITION_SEPARATOR ','
 #define MAPPING_SEPARATOR ':'
+#define TARGET_SEPARATOR '|'
 #define MAP_OPEN "["
 #define MAP_CLOSE "]"
 #define BLOCK_START "{"
 #define BLOCK_END "}"
 #define END_STATE "END"
+#define EPSILON "EPSILON"
+#define DEFAULT_INPUT "*"
+#define CLASS_SEPARATOR ','
 #define IN "IN"
 #define STATE "state"
 #define IN_MARKER "$in"
+#define SRC "SRC"
+#define SRC_MARKER "$src"
 #define COMMENT "//"
 
 // Output actions
 #define PRINT "PRINT"
 #define WRITE "WRITE"
 
+// Aggregate actions
+#define COUNT "COUNT"
+
+// Summary declarations and formats
+#define SUMMARY "SUMMARY"
+#define SUMMARY_TEXT "text"
+#define SUMMARY_JSON "json"
+
 // Input actions
 #define SCAN "SCAN"
 #define READ "READ"
+#define SCAN_SOURCE "stdin"
 
 // Regex strings
 #define GENERAL_ACTION "\\s+(.*)\\s+\"(.*?)\""	// Regex for parsing general 3-part actions
 #define STATE_VALUE "\\s+(.*)\\s*\\[(.*?)\\]"		// Regex for parsing the names and transitions of states
 #define CONSOLE_ACTION	"\\s*\"(.*)\""				// Regex for parsing PRINT and SCAN actions
+#define COUNT_ACTION "\\s*(\"(.*)\")?"			// Regex for parsing COUNT actions
 #define VALID_IDENTIFIER "^[a-zA-Z_][a-zA-Z_0-9]*$"			// Regex for checking for a valid identifier name
 
+// Fewest lines or states each parsing or checking thread is given
+#define PARALLEL_GRAIN 16384
+
 #include <cctype>
 #include <iostream>
 #include <fstream>
@@ -38,9 +58,15 @@
 #include <vector>
 #include <regex>
 #include <map>
+#include <set>
+#include <memory>
+#include <thread>
+#include <functional>
 #include "writer.h"
 #include "error.h"
 #include "action.h"
+#include "options.h"
+#include "nfa.h"
 
 using namespace std;
 
@@ -48,41 +74,61 @@ using namespace std;
 class Compiler {
 private:
 	string compiledName;						// Name of compiled file
+	Options options;							// Command line options
 	ifstream src;								// Source code file
 	map<string, string> files;					// Maps file names to file  paths
 	map<string, string> inputs;					// Maps input name to input string
+	map<string, vector<string>> classes;		// Maps input class names to the input names in them
 	map<string, map<string, string>> states;	// Maps states to transitions: state names -> (input -> another state name)
-	Action inputAction;							// Holds action object representing input action
+	Nfa nfa;									// Transitions as written in source, possibly nondeterministic
+	vector<Action> inputActions;				// Input actions in source order; each reads a different source
+	vector<int> inputActionLines;				// Line each input action was parsed on
 	map<string, vector<Action>> outputActions;	// Maps state name to a list of output actions
+	string summaryFormat;						// Format COUNT totals are emitted in at exit
 
 	int lineCount;								// Current line being parsed by compiler
 	bool attatchAction;							// Flag to track if actions are being parsed
-	bool inputActionParsed;						// Flag to track if an input action has already been parsed
 	string mostRecentState;						// The most recent state parsed from source
 	string firstState;							// The first state parsed from source
 
 	regex fileRegex;							// Regex to parse file declarations
 	regex inputRegex;							// Regex to parse input declarations
 	regex stateRegex;							// Regex to parse state declarations
+	regex classRegex;							// Regex to parse input class declarations
 	regex scanRegex;							// Regex to parse SCAN actions
 	regex readRegex;							// Regex to parse READ actions
 	regex writeRegex;							// Regex to parse WRITE statements
 	regex printRegex;							// Regex to parse PRINT statements
+	regex countRegex;							// Regex to parse COUNT statements
+	regex summaryRegex;							// Regex to parse SUMMARY declarations
 
 	static string trim(string);
 	static void split(string, char, vector<string>&);
 	static bool isValidIdentifier(string);
+	static bool isStateLine(string);
+	static void runParallel(int, function<void(int)>, vector<string>&);
 
 	string strDelimToChar(string);
 
 	void parseInputAndFileDeclarations(string);
 	void parseState(string);
+	void parseClass(string);
 	void parseInputAction(string);
 	void parseOutputAction(string);
+	void parseSummary(string);
+	void parseLine(string);
+	void parseChunks(vector<string>&, int);
+	void chunkBoundaries(vector<string>&, size_t, vector<size_t>&);
+	void mergeChunk(Compiler&, string);
+	int workers(size_t);
 	void checkForParseErrors();
+	void checkTransitions(vector<const pair<const string, map<string, set<string>>>*>&, size_t, size_t);
+	void buildStates();
+
+	Compiler(Options, int);
 
 public:
-	Compiler(string);
+	Compiler(string, Options);
 	~Compiler();
 
 	void parse();
@@ -0,0 +1,77 @@
+#include "corpus.h"
+#include <cstdint>
+#include <fstream>
+#include <vector>
+#include <unordered_map>
+#include "bytemachine.h"
+#include "error.h"
+
+namespace Corpus {
+
+	// Writes the given integer to the given stream in native byte order
+	template <typename T>
+	static void writeInt(ofstream &out, T value) {
+		out.write((const char*)&value, sizeof(value));
+	}
+
+	// Splits the file at the given input path at the given delimiter exactly like getline, and writes the
+	// dictionary-encoded tokens to the given output path
+	void tokenize(string inputPath, string delimiter, string outputPath) {
+		ifstream in(inputPath, ios::binary);
+		if (!in) Error::corpusOpenError(inputPath);
+
+		// Delimiter may be given as an escape sequence, such as \n
+		string delimiterBytes = ByteMachine::unescape(delimiter);
+		if (delimiterBytes.size() != 1) Error::invalidCorpusDelimiter(delimiter);
+
+		// Unique tokens in order of first appearance, and the ID of each
+		vector<string> dictionary;
+		unordered_map<string, uint32_t> ids;
+
+		// ID of every token in input order
+		vector<uint32_t> tokens;
+
+		string token;
+		while (getline(in, token, delimiterBytes[0])) {
+			unordered_map<string, uint32_t>::iterator it = ids.find(token);
+
+			if (it == ids.end()) {
+				it = ids.insert(make_pair(token, (uint32_t)dictionary.size())).first;
+				dictionary.push_back(token);
+			}
+
+			tokens.push_back(it->second);
+		}
+
+		// Use the narrowest ID width that fits every token
+		uint32_t width = dictionary.size() <= UINT8_MAX + 1 ? 1 : dictionary.size() <= UINT16_MAX + 1 ? 2 : 4;
+
+		// Offsets of each token in the dictionary bytes
+		vector<uint64_t> offsets(1, 0);
+		for (string entry : dictionary) offsets.push_back(offsets.back() + entry.size());
+
+		ofstream out(outputPath, ios::binary);
+		if (!out) Error::corpusOpenError(outputPath);
+
+		// Header
+		out.write(CORPUS_MAGIC, 4);
+		writeInt<uint32_t>(out, CORPUS_VERSION);
+		writeInt<uint32_t>(out, (unsigned char)delimiterBytes[0]);
+		writeInt<uint32_t>(out, width);
+		writeInt<uint64_t>(out, dictionary.size());
+		writeInt<uint64_t>(out, tokens.size());
+		writeInt<uint64_t>(out, offsets.back());
+
+		// Dictionary
+		for (uint64_t offset : offsets) writeInt<uint64_t>(out, offset);
+		for (string entry : dictionary) out.write(entry.data(), entry.size());
+		for (uint64_t i = offsets.back(); i % 8 != 0; ++i) out.put(0);
+
+		// Token IDs
+		for (uint32_t id : tokens) {
+			if (width == 1) writeInt<uint8_t>(out, id);
+			else if (width == 2) writeInt<uint16_t>(out, id);
+			else writeInt<uint32_t>(out, id);
+		}
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+// Corpus file layout; all integers are in native byte order
+#define CORPUS_MAGIC "STOK"		// First four bytes of every corpus file
+#define CORPUS_VERSION 1		// Version of the layout below
+#define CORPUS_EXTENSION ".stok"
+
+#include <string>
+
+using namespace std;
+
+// Namespace with functions for pre-tokenizing input into corpus files. A corpus file holds a header of
+// magic, version, delimiter and ID width as 32-bit integers, then dictionary size, token count and dictionary
+// byte count as 64-bit integers. The header is followed by dictionary size + 1 64-bit offsets into the
+// dictionary bytes, the dictionary bytes padded to 8 bytes, and one fixed-width ID per token
+namespace Corpus {
+	void tokenize(string, string, string);
+}
+
+#endif
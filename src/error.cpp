@@ -2,99 +2,210 @@
 
 namespace Error {
 
+	// Errors end compilation at once unless deferred
+	thread_local bool deferred = false;
+
+	// Holds the message of a deferred error until it is thrown
+	static thread_local ostringstream deferredMessage;
+
+	// Returns the stream errors are written to
+	static ostream& stream() {
+		if (deferred) return deferredMessage;
+		return cerr;
+	}
+
+	// Ends compilation, or unwinds to the thread that deferred errors with the message written so far
+	static void fail() {
+		if (!deferred) exit(1);
+
+		string message = deferredMessage.str();
+		deferredMessage.str("");
+		throw DeferredError(message);
+	}
+
+	// Reports an error deferred by another thread
+	void reportDeferred(string message) {
+		cerr << message;
+		exit(1);
+	}
+
 	// Error thrown if user tries to define their own END state
 	void endStateClash(int line) {
-		cerr << ERROR_MESSAGE " Cannot create state named " << END_STATE << " on line " << line << " as it is a reserved state name\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Cannot create state named " << END_STATE << " on line " << line << " as it is a reserved state name\n";
+		fail();
 	}
 
 	// Error thrown if a block is not ended before another one is started
 	void missingClosingBrace(int line) {
-		cerr << ERROR_MESSAGE " Missing closing brace on line " << line << "\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Missing closing brace on line " << line << "\n";
+		fail();
 	}
 
 	// Error thrown if a block is closed without one being opened
 	void missingOpeningBrace(int line) {
-		cerr << ERROR_MESSAGE " Missing opening brace in body of state ending on line " << line << "\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Missing opening brace in body of state ending on line " << line << "\n";
+		fail();
 	}
 
 	// Error thrown if user tries to run an unknown output action
 	void unknownOutputAction(int line) {
-		cerr << ERROR_MESSAGE " Unknown output action on line " << line << "\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Unknown output action on line " << line << "\n";
+		fail();
 	}
 
 	// Error thrown when actions are missing parts or not correctly formed
 	void malformedAction(int line) {
-		cerr << ERROR_MESSAGE " Malformed action on line " << line << "\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Malformed action on line " << line << "\n";
+		fail();
 	}
 
 	// Error thrown when no inputs are defined
 	void noInputs() {
-		cerr << ERROR_MESSAGE " Cannot create a finite-state machine without defined inputs\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Cannot create a finite-state machine without defined inputs\n";
+		fail();
 	}
 
 	// Error thrown when no states are defined
 	void noStates() {
-		cerr << ERROR_MESSAGE " Cannot create a finite-state machine with no states\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Cannot create a finite-state machine with no states\n";
+		fail();
 	}
 
 	// Error thrown if an identifier is not valid
 	void invalidIdentifier(int line, string id) {
-		cerr << ERROR_MESSAGE " Invalid identifier '" << id << "' at line " << line << "\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Invalid identifier '" << id << "' at line " << line << "\n";
+		fail();
 	}
 
-	// Error thrown if a user tries to define more than one input action
-	void multipleInputActions(int line) {
-		cerr << ERROR_MESSAGE " Only one input action is allowed per finite-state machine. A second input action was defined on line " << line << "\n";
-		exit(1);
+	// Error thrown if two input actions read the same source
+	void duplicateInputSource(int line, string source) {
+		stream() << ERROR_MESSAGE " Input source '" << source << "' is already read by another input action. It was read again on line " << line << "\n";
+		fail();
+	}
+
+	// Error thrown if a file is given the name standard input is read under
+	void reservedSourceName(int line, string name) {
+		stream() << ERROR_MESSAGE " File name '" << name << "' at line " << line << " is reserved for standard input, which SCAN reads\n";
+		fail();
 	}
 
 	// Error thrown if given input delimiter 
 	void invalidDelimiter(int line, string delim) {
-		cerr << ERROR_MESSAGE " Invalid delimiter '" << delim << "' at line " << line << ". Delimiters must not be more than one character";
-		exit(1);
+		stream() << ERROR_MESSAGE " Invalid delimiter '" << delim << "' at line " << line << ". Delimiters must not be more than one character";
+		fail();
 	}
 
 	// Error thrown if user tries to read or write from a file that was not declared
 	void referencingUndeclaredFile(string identifier) {
-		cerr << ERROR_MESSAGE " Attempting file I/O on undeclared file '" << identifier << "'\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Attempting file I/O on undeclared file '" << identifier << "'\n";
+		fail();
 	}
 
 	// Error thrown if user references undeclared input
 	void referencingUndeclaredInput(string input) {
-		cerr << ERROR_MESSAGE " Referencing undeclared input '" << input << "'\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Referencing undeclared input '" << input << "'\n";
+		fail();
 	}
 
 	// Error thrown if user references undeclared state
 	void referencingUndeclaredState(string state) {
-		cerr << ERROR_MESSAGE " Referencing undeclared state '" << state << "'\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Referencing undeclared state '" << state << "'\n";
+		fail();
 	}
 
 	// Error thrown if user does not define an input action
 	void noInputActions() {
-		cerr << ERROR_MESSAGE " At least one input action must be defined\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " At least one input action must be defined\n";
+		fail();
 	}
 
 	// Error thrown if source file could not be opened
 	void sourceOpenError(string path) {
-		cerr << ERROR_MESSAGE " Source file at path '" << path << "' could not be opened. Does the file exist at the given path?\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Source file at path '" << path << "' could not be opened. Does the file exist at the given path?\n";
+		fail();
 	}
 
 	// Error thrown if parser doesn't know how to handle this line
 	void unknownStatement(int line, string statement) {
-		cerr << ERROR_MESSAGE " Unknown statement '" << statement << "' at line " << line << "\n";
-		exit(1);
+		stream() << ERROR_MESSAGE " Unknown statement '" << statement << "' at line " << line << "\n";
+		fail();
+	}
+
+	// Error thrown if the compiler is given a flag it does not recognize
+	void unknownOption(string option) {
+		stream() << ERROR_MESSAGE " Unknown option '" << option << "'\n";
+		fail();
+	}
+
+	// Error thrown if a flag is missing its value or given an invalid one
+	void invalidOptionValue(string option) {
+		stream() << ERROR_MESSAGE " Missing or invalid value for option '" << option << "'\n";
+		fail();
+	}
+
+	// Error thrown if a SUMMARY declaration names an unsupported format
+	void invalidSummaryFormat(int line, string format) {
+		stream() << ERROR_MESSAGE " Invalid summary format '" << format << "' at line " << line << ". Expected '" SUMMARY_TEXT "' or '" SUMMARY_JSON "'\n";
+		fail();
+	}
+
+	// Error thrown if an input class has the same name as an input
+	void classInputClash(string name) {
+		stream() << ERROR_MESSAGE " Input class '" << name << "' has the same name as a declared input\n";
+		fail();
+	}
+
+	// Error thrown if a byte-level machine needs more DFA states than subset construction is allowed to create
+	void byteLevelDfaTooLarge(size_t limit) {
+		stream() << ERROR_MESSAGE " Byte-level machines need a complete DFA, but this machine needs more than " << limit << " states. Raise the limit with " DFA_LIMIT_FLAG "\n";
+		fail();
+	}
+
+	// Error thrown if a profile file could not be opened
+	void profileOpenError(string path) {
+		stream() << ERROR_MESSAGE " Profile at path '" << path << "' could not be opened. Does the file exist at the given path?\n";
+		fail();
+	}
+
+	// Error thrown if a line of a profile file cannot be parsed
+	void malformedProfile(string path, int line) {
+		stream() << ERROR_MESSAGE " Malformed profile entry in '" << path << "' on line " << line << "\n";
+		fail();
+	}
+
+	// Error thrown if profiling is requested for a machine compiled in a mode that cannot record it
+	void profileUnsupported() {
+		stream() << ERROR_MESSAGE " Profiling is only supported for delimiter-split machines with a complete DFA\n";
+		fail();
+	}
+
+	// Error thrown if a file being tokenized or the corpus being written could not be opened
+	void corpusOpenError(string path) {
+		stream() << ERROR_MESSAGE " File at path '" << path << "' could not be opened for tokenizing\n";
+		fail();
+	}
+
+	// Error thrown if the delimiter given for tokenizing is not a single character
+	void invalidCorpusDelimiter(string delim) {
+		stream() << ERROR_MESSAGE " Invalid delimiter '" << delim << "'. Delimiters must be one character or an escape sequence\n";
+		fail();
+	}
+
+	// Error thrown if corpus input is requested for a byte-level machine
+	void corpusUnsupported() {
+		stream() << ERROR_MESSAGE " Corpus input cannot be used with byte-level machines\n";
+		fail();
+	}
+
+	// Error thrown if table-driven output is combined with a mode the table interpreter does not support
+	void tablesUnsupported() {
+		stream() << ERROR_MESSAGE " " TABLES_FLAG " needs a complete DFA and cannot be combined with " BYTES_FLAG ", " CORPUS_FLAG ", " ASYNC_FLAG " or " PROFILE_GEN_FLAG "\n";
+		fail();
+	}
+
+	// Error thrown if several input actions are combined with a mode that reads a single input
+	void multiplexUnsupported() {
+		stream() << ERROR_MESSAGE " Multiple input actions cannot be combined with " BYTES_FLAG ", " CORPUS_FLAG " or " TABLES_FLAG "\n";
+		fail();
 	}
 }
\ No newline at end of file
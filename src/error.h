@@ -5,12 +5,26 @@
 
 #include <iostream>
 #include <string>
+#include <sstream>
 #include "compiler.h"
 
 using namespace std;
 
 // Namespace with functions needed to throw errors
 namespace Error {
+	// Thrown by errors raised while deferred instead of exiting; holds the message that would have been printed
+	class DeferredError {
+	public:
+		string message;
+
+		DeferredError(string m) { message = m; }
+		~DeferredError(){}
+	};
+
+	// Set on threads whose errors are collected and reported in line order instead of ending compilation
+	extern thread_local bool deferred;
+
+	void reportDeferred(string);
 	void endStateClash(int);
 	void missingClosingBrace(int);
 	void missingOpeningBrace(int);
@@ -19,7 +33,8 @@ namespace Error {
 	void noInputs();
 	void noStates();
 	void invalidIdentifier(int, string);
-	void multipleInputActions(int);
+	void duplicateInputSource(int, string);
+	void reservedSourceName(int, string);
 	void invalidDelimiter(int, string);
 	void referencingUndeclaredFile(string);
 	void referencingUndeclaredInput(string);
@@ -27,6 +42,19 @@ namespace Error {
 	void noInputActions();
 	void sourceOpenError(string);
 	void unknownStatement(int, string);
+	void unknownOption(string);
+	void invalidOptionValue(string);
+	void invalidSummaryFormat(int, string);
+	void classInputClash(string);
+	void byteLevelDfaTooLarge(size_t);
+	void profileOpenError(string);
+	void malformedProfile(string, int);
+	void profileUnsupported();
+	void corpusOpenError(string);
+	void invalidCorpusDelimiter(string);
+	void corpusUnsupported();
+	void tablesUnsupported();
+	void multiplexUnsupported();
 }
 
 #endif
\ No newline at end of file
@@ -1,8 +1,11 @@
 #include <iostream>
+#include <cstdlib>
 #include "compiler.h"
+#include "options.h"
+#include "corpus.h"
 
-#define FILE_INDEX 1
 #define EXPECTED_INPUT_SIZE 2
+#define EXPECTED_TOKENIZE_SIZE 5
 
 int main(int argc, char* argv[]) {
 	// Check for correct number of arguments
@@ -11,10 +14,58 @@ int main(int argc, char* argv[]) {
 		return 1;
 	}
 
+	// Tokenizing takes an input path, a delimiter and an output path instead of a source file
+	if (string(argv[1]) == TOKENIZE_FLAG) {
+		if (argc < EXPECTED_TOKENIZE_SIZE) {
+			cerr << "Usage: statec " TOKENIZE_FLAG " <input> <delimiter> <output" CORPUS_EXTENSION ">\n";
+			return 1;
+		}
+
+		Corpus::tokenize(argv[2], argv[3], argv[4]);
+		return 0;
+	}
+
+	// Options parsed from flags and path of the source file
+	Options options;
+	string path;
+
+	// Parse flags; the one non-flag argument is the source path
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+
+		if (arg == ASYNC_FLAG) options.asyncOutput = true;
+		else if (arg == BYTES_FLAG) options.byteLevel = true;
+		else if (arg == PROFILE_GEN_FLAG) options.profileGen = true;
+		else if (arg == CORPUS_FLAG) options.corpusInput = true;
+		else if (arg == TABLES_FLAG) options.tableDriven = true;
+		else if (arg == PROFILE_USE_FLAG) {
+			// Profile path must be given as the next argument
+			if (i + 1 >= argc) Error::invalidOptionValue(arg);
+			options.profileUse = argv[++i];
+		}
+		else if (arg == DFA_LIMIT_FLAG) {
+			// Limit must be a positive number given as the next argument
+			if (i + 1 >= argc || atoll(argv[i + 1]) <= 0) Error::invalidOptionValue(arg);
+			options.dfaLimit = atoll(argv[++i]);
+		}
+		else if (arg == JOBS_FLAG) {
+			// Thread count must be a positive number given as the next argument
+			if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) Error::invalidOptionValue(arg);
+			options.jobs = atoi(argv[++i]);
+		}
+		else if (arg.rfind("--", 0) != string::npos) Error::unknownOption(arg);
+		else path = arg;
+	}
+
+	if (path.empty()) {
+		cerr << "Please provide a valid source file path\n";
+		return 1;
+	}
+
 	// Create
-	Compiler c(argv[FILE_INDEX]);
+	Compiler c(path, options);
 	c.parse();
 	c.compile();
 
 	return 0;
-}
\ No newline at end of file
+}
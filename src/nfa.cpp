@@ -0,0 +1,214 @@
+#include "nfa.h"
+#include "compiler.h"
+
+// Returns true if every transition has exactly one target and there are no epsilon moves
+bool Nfa::isDeterministic() {
+	for (pair<string, map<string, set<string>>> state : transitions) {
+		for (pair<string, set<string>> trans : state.second) {
+			if (trans.first == EPSILON || trans.second.size() > 1) return false;
+		}
+	}
+	return true;
+}
+
+// Returns the given states along with every state reachable from them through epsilon moves
+set<string> Nfa::closure(set<string> states) {
+	// States whose epsilon moves have not been followed yet
+	vector<string> pending(states.begin(), states.end());
+
+	while (!pending.empty()) {
+		string current = pending.back();
+		pending.pop_back();
+
+		// END and sink states have no moves to follow
+		if (!transitions.count(current) || !transitions[current].count(EPSILON)) continue;
+
+		for (string target : transitions[current][EPSILON]) {
+			if (states.insert(target).second) pending.push_back(target);
+		}
+	}
+
+	return states;
+}
+
+// Returns the closure of states reached from the given states on the given input. Passing DEFAULT_INPUT gives
+// the states reached on inputs no transition lists
+set<string> Nfa::move(const set<string> &states, string input) {
+	set<string> reached;
+
+	for (string state : states) {
+		// Inputs not listed in a state's transitions take its default transition, or loop back to the state itself
+		if (transitions.count(state) && transitions[state].count(input)) {
+			set<string> &targets = transitions[state][input];
+			reached.insert(targets.begin(), targets.end());
+		} else if (transitions.count(state) && transitions[state].count(DEFAULT_INPUT)) {
+			set<string> &targets = transitions[state][DEFAULT_INPUT];
+			reached.insert(targets.begin(), targets.end());
+		} else {
+			reached.insert(state);
+		}
+	}
+
+	return closure(reached);
+}
+
+// Returns every input named in a transition, in name order
+vector<string> Nfa::symbols() {
+	set<string> used;
+
+	for (pair<string, map<string, set<string>>> state : transitions) {
+		for (pair<string, set<string>> trans : state.second) {
+			if (trans.first != EPSILON && trans.first != DEFAULT_INPUT) used.insert(trans.first);
+		}
+	}
+
+	return vector<string>(used.begin(), used.end());
+}
+
+// Replaces transitions on input classes with transitions on each input in the class. Transitions naming an input
+// directly take precedence over ones through a class
+void Nfa::expandClasses(map<string, vector<string>> &classes) {
+	for (pair<const string, map<string, set<string>>> &state : transitions) {
+		// Transitions on inputs named directly
+		map<string, set<string>> expanded;
+		for (pair<string, set<string>> trans : state.second) {
+			if (!classes.count(trans.first)) expanded[trans.first] = trans.second;
+		}
+
+		// Transitions through classes; repeated classes add targets
+		map<string, set<string>> throughClasses;
+		for (pair<string, set<string>> trans : state.second) {
+			if (!classes.count(trans.first)) continue;
+
+			for (string input : classes[trans.first]) throughClasses[input].insert(trans.second.begin(), trans.second.end());
+		}
+
+		for (pair<string, set<string>> trans : throughClasses) {
+			if (!expanded.count(trans.first)) expanded[trans.first] = trans.second;
+		}
+
+		state.second = expanded;
+	}
+}
+
+// Converts a deterministic machine directly to single-target transitions
+void Nfa::toDfa(map<string, map<string, string>> &states) {
+	states.clear();
+
+	for (pair<string, map<string, set<string>>> state : transitions) {
+		// Maps input names to state names; represents transitions
+		map<string, string> transitionMap;
+
+		// Unlisted inputs go to the default target, or loop back to the current state
+		string defaultTarget = state.first;
+		if (state.second.count(DEFAULT_INPUT)) defaultTarget = *state.second[DEFAULT_INPUT].begin();
+
+		for (pair<string, set<string>> trans : state.second) {
+			string target = *trans.second.begin();
+
+			// Transitions that match what unlisted inputs do are implicit
+			if (trans.first == DEFAULT_INPUT) {
+				if (target != state.first) transitionMap[trans.first] = target;
+			} else if (target != defaultTarget) {
+				transitionMap[trans.first] = target;
+			}
+		}
+
+		// If there are no transitions, put a blank string mapping in the states map to indicate sink state
+		if (transitionMap.empty()) transitionMap[""] = "";
+
+		states[state.first] = transitionMap;
+	}
+}
+
+// Returns the DFA state name for the given subset of NFA states
+string Nfa::subsetName(const set<string> &subset, int index) {
+	// Reaching END in any branch ends the machine
+	if (subset.count(END_STATE)) return END_STATE;
+
+	// Singletons keep the name of the state they came from
+	if (subset.size() == 1) return *subset.begin();
+
+	// Numbered name that does not clash with a declared state
+	string name = "set" + to_string(index);
+	while (transitions.count(name)) name = "_" + name;
+
+	return name;
+}
+
+// Runs subset construction starting from the given first state, which is renamed to the DFA start state. Fills
+// states with the reachable DFA states and adds the combined output actions of each subset to actions. Returns
+// false if more than limit states are needed
+bool Nfa::determinize(string &first, size_t limit, map<string, map<string, string>> &states, map<string, vector<Action>> &actions) {
+	vector<string> inputs = symbols();
+
+	// Maps subsets to their DFA state names
+	map<set<string>, string> names;
+
+	// Subsets whose transitions have not been computed yet
+	vector<set<string>> pending;
+
+	// Output actions of subsets, added to actions once construction succeeds
+	map<string, vector<Action>> combinedActions;
+
+	set<string> start = closure({ first });
+	names[start] = subsetName(start, 0);
+	pending.push_back(start);
+
+	// Unlisted inputs are one more symbol to move on
+	inputs.push_back(DEFAULT_INPUT);
+
+	states.clear();
+
+	while (!pending.empty()) {
+		set<string> current = pending.back();
+		pending.pop_back();
+
+		string currentName = names[current];
+
+		// END is built in and has no transitions
+		if (currentName == END_STATE) continue;
+
+		// Maps input names to state names; represents transitions
+		map<string, string> transitionMap;
+
+		// Subset reached on unlisted inputs
+		set<string> defaultNext = move(current, DEFAULT_INPUT);
+
+		for (string input : inputs) {
+			set<string> next = move(current, input);
+
+			// Transitions that match what unlisted inputs do are implicit
+			if (input == DEFAULT_INPUT ? next == current : next == defaultNext) continue;
+
+			if (!names.count(next)) {
+				if (names.size() >= limit) return false;
+
+				names[next] = subsetName(next, names.size());
+				pending.push_back(next);
+			}
+
+			transitionMap[input] = names[next];
+		}
+
+		// If there are no transitions, put a blank string mapping in the states map to indicate sink state
+		if (transitionMap.empty()) transitionMap[""] = "";
+
+		states[currentName] = transitionMap;
+
+		// Subsets run the output actions of every state they contain
+		if (current.size() > 1) {
+			vector<Action> combined;
+			for (string member : current) {
+				if (actions.count(member)) combined.insert(combined.end(), actions[member].begin(), actions[member].end());
+			}
+			combinedActions[currentName] = combined;
+		}
+	}
+
+	for (pair<string, vector<Action>> subsetActions : combinedActions) actions[subsetActions.first] = subsetActions.second;
+
+	first = names[start];
+
+	return true;
+}
@@ -0,0 +1,35 @@
+#ifndef NFA_H
+#define NFA_H
+
+#define DEFAULT_DFA_LIMIT 4096	// Default number of DFA states subset construction may create
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include "action.h"
+
+using namespace std;
+
+// Class holding a possibly nondeterministic machine and the subset construction that turns it into a DFA
+class Nfa {
+private:
+	string subsetName(const set<string>&, int);
+
+public:
+	map<string, map<string, set<string>>> transitions;	// Maps states to transitions: state names -> (input -> target state names)
+	bool lazy;											// True if the DFA is too big and must be built at runtime
+
+	Nfa() { lazy = false; }
+	~Nfa(){}
+
+	bool isDeterministic();
+	set<string> closure(set<string>);
+	set<string> move(const set<string>&, string);
+	vector<string> symbols();
+	void expandClasses(map<string, vector<string>>&);
+	void toDfa(map<string, map<string, string>>&);
+	bool determinize(string&, size_t, map<string, map<string, string>>&, map<string, vector<Action>>&);
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+// Command line flags
+#define ASYNC_FLAG "--async"
+#define DFA_LIMIT_FLAG "--dfa-limit"
+#define BYTES_FLAG "--bytes"
+#define PROFILE_GEN_FLAG "--profile-gen"
+#define PROFILE_USE_FLAG "--profile-use"
+#define CORPUS_FLAG "--corpus"
+#define TOKENIZE_FLAG "--tokenize"
+#define TABLES_FLAG "--tables"
+#define JOBS_FLAG "--jobs"
+
+#include <string>
+#include <thread>
+#include <algorithm>
+#include "nfa.h"
+
+using namespace std;
+
+// Class used for storing command line options given to the compiler
+class Options {
+public:
+	bool asyncOutput;	// Offload output actions to a dedicated writer thread
+	size_t dfaLimit;	// Most DFA states subset construction may create, and size of the runtime DFA cache
+	bool byteLevel;		// Match inputs byte by byte in one automaton instead of splitting at a delimiter
+	bool profileGen;	// Make compiled program record state visits and transition hits
+	string profileUse;	// Path of a recorded profile to lay out compiled code by
+	bool corpusInput;	// Make compiled program read a pre-tokenized corpus instead of its input action
+	bool tableDriven;	// Write the machine as a reloadable table file run by a generic program
+	int jobs;			// Most threads used to parse and check large sources
+
+	Options() { asyncOutput = false; dfaLimit = DEFAULT_DFA_LIMIT; byteLevel = false; profileGen = false; profileUse = ""; corpusInput = false; tableDriven = false; jobs = max(1u, thread::hardware_concurrency()); }
+	~Options(){}
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "profile.h"
+#include "error.h"
+
+// Loads a profile written by a program compiled with profiling enabled. Each line is either
+// "STATE <state> <visits>" or "TRANSITION <state> <input> <hits>"
+void Profile::load(string path) {
+	ifstream in(path);
+
+	// Check that profile exists
+	if (!in) Error::profileOpenError(path);
+
+	string line;
+	int lineCount = 1;
+
+	while (getline(in, line)) {
+		istringstream fields(line);
+		string kind;
+		string state;
+		string input;
+		unsigned long long count;
+
+		fields >> kind;
+
+		if (kind == PROFILE_STATE && fields >> state >> count) visits[state] += count;
+		else if (kind == PROFILE_TRANSITION && fields >> state >> input >> count) hits[state][input] += count;
+		else if (!kind.empty()) Error::malformedProfile(path, lineCount);
+
+		++lineCount;
+	}
+}
+
+// Returns number of times the given state was visited
+unsigned long long Profile::visitsOf(string state) {
+	return visits.count(state) ? visits[state] : 0;
+}
+
+// Returns number of times the given input was received in the given state
+unsigned long long Profile::hitsOf(string state, string input) {
+	if (!hits.count(state) || !hits[state].count(input)) return 0;
+	return hits[state][input];
+}
@@ -0,0 +1,34 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Profile file keywords
+#define PROFILE_STATE "STATE"
+#define PROFILE_TRANSITION "TRANSITION"
+#define PROFILE_EXTENSION ".profile"
+
+// Environment variable profiled programs take their profile path from, if set
+#define PROFILE_ENV "STATE_PROFILE"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+
+using namespace std;
+
+// Class holding per-state visit counts and per-transition hit counts captured from a run of a compiled program
+class Profile {
+public:
+	map<string, unsigned long long> visits;					// Maps state names to the number of times they were visited
+	map<string, map<string, unsigned long long>> hits;		// Maps state names to inputs to the number of times they were received
+
+	Profile(){}
+	~Profile(){}
+
+	bool empty() { return visits.empty() && hits.empty(); }
+	void load(string);
+	unsigned long long visitsOf(string);
+	unsigned long long hitsOf(string, string);
+};
+
+#endif
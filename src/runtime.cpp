@@ -0,0 +1,827 @@
+#include "runtime.h"
+
+namespace Runtime {
+
+	// Lock-free single-producer/single-consumer ring of output records. The state-stepping loop pushes
+	// static fragments and copies of $in, and a writer thread drains them to their sinks with writev. Either
+	// side sleeps on a condition variable while it cannot make progress, and is only woken by the other side
+	// when the ring leaves the empty or full state it is waiting on
+	const char* ASYNC_OUTPUT = R"(namespace statert {
+// Output record; either a static string fragment or a copied slice of the current input
+struct Record {
+	int fd;
+	const char* data;
+	size_t len;
+	string slice;
+};
+
+class OutputRing {
+	static const size_t CAPACITY = 1 << 14;
+	static const size_t MASK = CAPACITY - 1;
+	static const int BATCH = 64;
+	Record slots[CAPACITY];
+	atomic<size_t> head{0};
+	atomic<size_t> tail{0};
+	atomic<bool> done{false};
+	atomic<bool> writerWaiting{false};
+	atomic<bool> producerWaiting{false};
+	mutex sleeping;
+	condition_variable wakeWriter;
+	condition_variable wakeProducer;
+	thread writer;
+
+	// Waits for a free slot, applying backpressure to the producer while the ring is full
+	size_t claim() {
+		size_t t = tail.load(memory_order_relaxed);
+		while (t - head.load(memory_order_acquire) == CAPACITY) {
+			unique_lock<mutex> lock(sleeping);
+			producerWaiting.store(true);
+			if (t - head.load() == CAPACITY) wakeProducer.wait(lock);
+			producerWaiting.store(false, memory_order_relaxed);
+		}
+		return t;
+	}
+
+	// Publishes the record in the claimed slot, waking the writer if it is waiting on an empty ring
+	void publish(size_t t) {
+		tail.store(t + 1);
+		if (writerWaiting.load()) {
+			lock_guard<mutex> lock(sleeping);
+			wakeWriter.notify_one();
+		}
+	}
+
+	// Sleeps until the producer publishes a record or finishes
+	void awaitRecords(size_t h) {
+		unique_lock<mutex> lock(sleeping);
+		writerWaiting.store(true);
+		if (h == tail.load() && !done.load()) wakeWriter.wait(lock);
+		writerWaiting.store(false, memory_order_relaxed);
+	}
+
+	// Writes every byte described by the given vectors, retrying partial writes
+	static void flush(int fd, struct iovec* iov, int count) {
+		while (count > 0) {
+			ssize_t n = writev(fd, iov, count);
+			if (n < 0) {
+				if (errno == EINTR) continue;
+				return;
+			}
+			while (count > 0 && (size_t)n >= iov->iov_len) {
+				n -= iov->iov_len;
+				++iov;
+				--count;
+			}
+			if (count > 0) {
+				iov->iov_base = (char*)iov->iov_base + n;
+				iov->iov_len -= n;
+			}
+		}
+	}
+
+	// Writer thread body; batches consecutive records bound for the same sink into one writev
+	void drain() {
+		struct iovec iov[BATCH];
+		for (;;) {
+			size_t h = head.load(memory_order_relaxed);
+			size_t t = tail.load(memory_order_acquire);
+			if (h == t) {
+				if (done.load(memory_order_acquire) && h == tail.load(memory_order_acquire)) return;
+				awaitRecords(h);
+				continue;
+			}
+			int fd = slots[h & MASK].fd;
+			size_t end = h;
+			int count = 0;
+			while (end != t && count < BATCH && slots[end & MASK].fd == fd) {
+				Record& r = slots[end & MASK];
+				iov[count].iov_base = (void*)(r.data ? r.data : r.slice.data());
+				iov[count].iov_len = r.data ? r.len : r.slice.size();
+				++count;
+				++end;
+			}
+			flush(fd, iov, count);
+			head.store(end);
+
+			// Wake the producer if it is waiting on a full ring
+			if (producerWaiting.load()) {
+				lock_guard<mutex> lock(sleeping);
+				wakeProducer.notify_one();
+			}
+		}
+	}
+public:
+	void push(int fd, const char* data, size_t len) {
+		size_t t = claim();
+		Record& r = slots[t & MASK];
+		r.fd = fd;
+		r.data = data;
+		r.len = len;
+		publish(t);
+	}
+	void push(int fd, const string& slice) {
+		size_t t = claim();
+		Record& r = slots[t & MASK];
+		r.fd = fd;
+		r.data = nullptr;
+		r.slice.assign(slice);
+		publish(t);
+	}
+	void start() { writer = thread(&OutputRing::drain, this); }
+	void finish() {
+		done.store(true);
+		{
+			lock_guard<mutex> lock(sleeping);
+			wakeWriter.notify_one();
+		}
+		writer.join();
+	}
+};
+OutputRing ring;
+}
+)";
+
+	// Writes COUNT totals and $in histograms as text or JSON. Shared by compiled machines and the table interpreter
+	const char* SUMMARY_WRITER = R"(namespace statert {
+// Total of one counted state with its $in histogram sorted by input value
+struct Total {
+	string name;
+	unsigned long long count;
+	vector<pair<string, unsigned long long>> histogram;
+};
+
+// Escapes the given string for use inside a JSON string literal
+string jsonEscape(const string& s) {
+	static const char* HEX = "0123456789abcdef";
+	string escaped;
+	for (unsigned char c : s) {
+		if (c == '"' || c == '\\') escaped += string("\\") + (char)c;
+		else if (c < 0x20) escaped += string("\\u00") + HEX[c >> 4] + HEX[c & 0xf];
+		else escaped += c;
+	}
+	return escaped;
+}
+
+// Writes the given totals to the given stream, one line per state and input or as a single JSON object
+void writeSummary(ostream& out, const vector<Total>& totals, bool json) {
+	if (json) out << "{";
+	for (size_t i = 0; i < totals.size(); ++i) {
+		const Total& total = totals[i];
+		if (!json) {
+			out << total.name << " " << total.count << "\n";
+			for (const pair<string, unsigned long long>& entry : total.histogram)
+				out << "\t" << entry.first << " " << entry.second << "\n";
+			continue;
+		}
+		if (i > 0) out << ",";
+		out << "\"" << total.name << "\":{\"count\":" << total.count;
+		if (!total.histogram.empty()) {
+			out << ",\"inputs\":{";
+			for (size_t j = 0; j < total.histogram.size(); ++j) {
+				if (j > 0) out << ",";
+				out << "\"" << jsonEscape(total.histogram[j].first) << "\":" << total.histogram[j].second;
+			}
+			out << "}";
+		}
+		out << "}";
+	}
+	if (json) out << "}\n";
+}
+}
+)";
+
+	// Collects COUNT totals for SUMMARY_WRITER at exit. Expects COUNTED, countedNames, counts and histograms to
+	// have been declared in the namespace beforehand
+	const char* COUNT_SUMMARY = R"(namespace statert {
+// Returns the total of every counted state in declaration order
+vector<Total> totals() {
+	vector<Total> all(COUNTED);
+	for (int i = 0; i < COUNTED; ++i) {
+		all[i].name = countedNames[i];
+		all[i].count = counts[i];
+		all[i].histogram.assign(histograms[i].begin(), histograms[i].end());
+		sort(all[i].histogram.begin(), all[i].histogram.end());
+	}
+	return all;
+}
+}
+)";
+
+	// DFA built from NFA tables one state at a time as inputs arrive, keeping at most CACHE_LIMIT states.
+	// Expects NFA_STATES, END_INDEX, SYMBOLS, START, MOVE_OFFSETS, MOVE_TARGETS and CACHE_LIMIT to have been
+	// declared in the namespace beforehand
+	const char* LAZY_DFA = R"(namespace statert {
+const int WORDS = (NFA_STATES + 63) / 64;
+
+// DFA state; a set of NFA states along with transitions that have been computed so far
+struct DfaState {
+	vector<uint64_t> bits;
+	vector<int> members;
+	vector<int> next;
+};
+
+class LazyDfa {
+	vector<DfaState> states;
+	map<vector<uint64_t>, int> index;
+
+	// Returns the id of the DFA state for the given set, creating it if needed
+	int intern(const vector<uint64_t>& bits) {
+		map<vector<uint64_t>, int>::iterator it = index.find(bits);
+		if (it != index.end()) return it->second;
+
+		DfaState state;
+		state.bits = bits;
+		state.next.assign(SYMBOLS, -1);
+		for (int i = 0; i < NFA_STATES; ++i) {
+			if (bits[i / 64] >> (i % 64) & 1) state.members.push_back(i);
+		}
+		states.push_back(state);
+		index[bits] = states.size() - 1;
+		return states.size() - 1;
+	}
+public:
+	int start() {
+		vector<uint64_t> bits(WORDS, 0);
+		for (int s : START) bits[s / 64] |= (uint64_t)1 << (s % 64);
+		return intern(bits);
+	}
+
+	// Returns the DFA state reached from the given one on the given symbol
+	int step(int current, int symbol) {
+		int cached = states[current].next[symbol];
+		if (cached >= 0) return cached;
+
+		vector<uint64_t> bits(WORDS, 0);
+		for (int s : states[current].members) {
+			for (int i = MOVE_OFFSETS[s * SYMBOLS + symbol]; i < MOVE_OFFSETS[s * SYMBOLS + symbol + 1]; ++i)
+				bits[MOVE_TARGETS[i] / 64] |= (uint64_t)1 << (MOVE_TARGETS[i] % 64);
+		}
+
+		// Flush the cache when it is full, keeping only the current state
+		if (states.size() >= CACHE_LIMIT && !index.count(bits)) {
+			vector<uint64_t> currentBits = states[current].bits;
+			states.clear();
+			index.clear();
+			current = intern(currentBits);
+		}
+
+		int target = intern(bits);
+		states[current].next[symbol] = target;
+		return target;
+	}
+
+	const vector<int>& members(int id) { return states[id].members; }
+	bool ended(int id) { return states[id].bits[END_INDEX / 64] >> (END_INDEX % 64) & 1; }
+};
+LazyDfa dfa;
+}
+)";
+
+	// Writes recorded state visits and transition hits in the format read by statec. Expects PROFILE_ENV,
+	// STATE_COUNT, SYMBOL_COUNT, stateNames, symbolNames, visits and hits to have been declared in the namespace
+	// beforehand
+	const char* PROFILE_WRITER = R"(namespace statert {
+// Writes recorded counts to the given path, or to the path in the profile environment variable if it is set
+void writeProfile(const char* path) {
+	const char* runtimePath = getenv(PROFILE_ENV);
+	ofstream out(runtimePath ? runtimePath : path);
+	for (int s = 0; s < STATE_COUNT; ++s) {
+		if (visits[s] > 0) out << "STATE " << stateNames[s] << " " << visits[s] << "\n";
+		for (int i = 0; i < SYMBOL_COUNT; ++i) {
+			if (hits[s][i] > 0) out << "TRANSITION " << stateNames[s] << " " << symbolNames[i] << " " << hits[s][i] << "\n";
+		}
+	}
+}
+}
+)";
+
+	// Maps a corpus file written by statec --tokenize and walks its token IDs, translating the dictionary to
+	// symbols once when the corpus is opened. Expects symbolOf, CORPUS_MAGIC and CORPUS_VERSION to have been
+	// declared in the namespace beforehand
+	const char* CORPUS_READER = R"(namespace statert {
+class Corpus {
+	void* mapped = MAP_FAILED;
+	size_t size;
+	const char* dictionary;
+	const uint64_t* offsets;
+	const unsigned char* ids;
+	uint32_t width;
+	uint64_t count;
+	uint64_t position;
+	uint32_t id;
+	vector<int> symbols;
+
+	// Returns the ID of the token at the given position
+	uint32_t idAt(uint64_t i) const {
+		if (width == 1) return ids[i];
+		if (width == 2) return ((const uint16_t*)ids)[i];
+		return ((const uint32_t*)ids)[i];
+	}
+
+	// Unmaps the corpus after a failed open
+	bool reject() {
+		munmap(mapped, size);
+		mapped = MAP_FAILED;
+		return false;
+	}
+public:
+	int symbol;
+
+	~Corpus() {
+		if (mapped != MAP_FAILED) munmap(mapped, size);
+	}
+
+	// Maps the corpus at the given path. Returns false if it cannot be read or was split at another delimiter
+	bool open(const char* path, char delimiter) {
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat info;
+		if (fstat(fd, &info) < 0 || info.st_size < 40) {
+			close(fd);
+			return false;
+		}
+
+		size = info.st_size;
+		mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mapped == MAP_FAILED) return false;
+
+		const char* data = (const char*)mapped;
+		const uint32_t* header = (const uint32_t*)(data + sizeof(CORPUS_MAGIC) - 1);
+		if (memcmp(data, CORPUS_MAGIC, sizeof(CORPUS_MAGIC) - 1) != 0 || header[0] != CORPUS_VERSION || header[1] != (unsigned char)delimiter)
+			return reject();
+
+		width = header[2];
+		const uint64_t* sizes = (const uint64_t*)(header + 3);
+		uint64_t entries = sizes[0];
+		count = sizes[1];
+		if (width != 1 && width != 2 && width != 4) return reject();
+
+		// Each section must fit in what is left of the file; sizes are checked before they are used as offsets
+		offsets = sizes + 3;
+		uint64_t left = data + size - (const char*)offsets;
+		if (entries >= left / 8) return reject();
+		left -= (entries + 1) * 8;
+		if (sizes[2] > left || (sizes[2] + 7) / 8 * 8 > left) return reject();
+		uint64_t bytes = (sizes[2] + 7) / 8 * 8;
+		left -= bytes;
+		if (count > left / width) return reject();
+
+		dictionary = (const char*)(offsets + entries + 1);
+		ids = (const unsigned char*)(dictionary + bytes);
+
+		// Entries must follow each other within the dictionary bytes, and every ID must name an entry, so a
+		// truncated or stale corpus never reads past its sections
+		if (offsets[entries] > sizes[2]) return reject();
+		for (uint64_t i = 0; i < entries; ++i) {
+			if (offsets[i] > offsets[i + 1]) return reject();
+		}
+		for (uint64_t i = 0; i < count; ++i) {
+			if (idAt(i) >= entries) return reject();
+		}
+
+		// Translate each dictionary entry to its symbol once
+		symbols.resize(entries);
+		for (uint64_t i = 0; i < entries; ++i)
+			symbols[i] = symbolOf(string(dictionary + offsets[i], offsets[i + 1] - offsets[i]));
+
+		madvise(mapped, size, MADV_SEQUENTIAL);
+		position = 0;
+		return true;
+	}
+
+	// Advances to the next token. Returns false once every token has been read
+	bool next() {
+		if (position == count) return false;
+
+		id = idAt(position++);
+		symbol = symbols[id];
+		return true;
+	}
+
+	// Copies text of the current token into the given string
+	void text(string& in) {
+		in.assign(dictionary + offsets[id], offsets[id + 1] - offsets[id]);
+	}
+};
+Corpus corpus;
+}
+)";
+
+	// Runs a machine loaded from a table file written by statec --tables. A watcher thread polls the table
+	// file and publishes reloaded tables, which the stepping loop swaps in between inputs while carrying the
+	// current state over by name
+	const char* TABLE_INTERPRETER = R"(namespace statert {
+enum ActionKind { PRINT_ACTION, WRITE_ACTION, COUNT_ACTION };
+
+struct TableAction {
+	ActionKind kind;
+	int file;
+	vector<string> fragments;
+	string counted;
+	bool histogram;
+};
+
+// Immutable machine loaded from a table file; END is state -1
+struct Machine {
+	vector<string> names;
+	unordered_map<string, int> index;
+	unordered_map<string, int> symbolIds;
+	vector<vector<int>> next;
+	vector<vector<TableAction>> actions;
+	vector<string> fileNames;
+	vector<string> filePaths;
+	int start;
+	bool json;
+
+	int symbolOf(const string& in) const {
+		unordered_map<string, int>::const_iterator it = symbolIds.find(in);
+		return it == symbolIds.end() ? 0 : it->second;
+	}
+	int stateOf(const string& name) const {
+		if (name == "END") return -1;
+		unordered_map<string, int>::const_iterator it = index.find(name);
+		return it == index.end() ? -2 : it->second;
+	}
+};
+
+// Reads a string written as its length, a colon and its bytes
+bool readString(istream& in, string& s) {
+	size_t length;
+	if (!(in >> length) || in.get() != ':') return false;
+	s.resize(length);
+	return length == 0 || in.read(&s[0], length);
+}
+
+// Loads tables from the given path. Returns null if the file cannot be read or is malformed
+shared_ptr<const Machine> load(const string& path) {
+	ifstream in(path, ios::binary);
+	string magic;
+	int version;
+	int symbols;
+	if (!(in >> magic >> version) || magic != "STATETAB" || version != 1) return nullptr;
+	if (!(in >> magic >> symbols) || magic != "SYMBOLS" || symbols < 1) return nullptr;
+
+	shared_ptr<Machine> machine = make_shared<Machine>();
+	machine->start = -2;
+	machine->json = false;
+
+	string kind;
+	while (in >> kind) {
+		string name;
+		string text;
+		if (kind == "FILE") {
+			if (!(in >> name) || !readString(in, text)) return nullptr;
+			machine->fileNames.push_back(name);
+			machine->filePaths.push_back(text);
+		} else if (kind == "SYMBOL") {
+			int symbol;
+			if (!(in >> symbol) || !readString(in, text) || symbol < 1 || symbol >= symbols) return nullptr;
+			machine->symbolIds.insert(make_pair(text, symbol));
+		} else if (kind == "STATE") {
+			if (!(in >> name) || machine->index.count(name)) return nullptr;
+			machine->index[name] = machine->names.size();
+			machine->names.push_back(name);
+			machine->next.push_back(vector<int>(symbols, machine->names.size() - 1));
+			machine->actions.push_back(vector<TableAction>());
+		} else if (kind == "TRANSITION") {
+			string target;
+			int symbol;
+			if (!(in >> name >> symbol >> target) || symbol < 0 || symbol >= symbols) return nullptr;
+			int from = machine->stateOf(name);
+			int to = machine->stateOf(target);
+			if (from < 0 || to < -1) return nullptr;
+			machine->next[from][symbol] = to;
+		} else if (kind == "PRINT" || kind == "WRITE") {
+			TableAction action;
+			action.kind = kind == "PRINT" ? PRINT_ACTION : WRITE_ACTION;
+			action.file = -1;
+			int fragments;
+			if (!(in >> name)) return nullptr;
+			if (action.kind == WRITE_ACTION) {
+				string file;
+				if (!(in >> file)) return nullptr;
+				vector<string>::iterator it = find(machine->fileNames.begin(), machine->fileNames.end(), file);
+				if (it == machine->fileNames.end()) return nullptr;
+				action.file = it - machine->fileNames.begin();
+			}
+			if (!(in >> fragments) || fragments < 1) return nullptr;
+			action.fragments.resize(fragments);
+			for (string& fragment : action.fragments) {
+				if (!readString(in, fragment)) return nullptr;
+			}
+			int state = machine->stateOf(name);
+			if (state < 0) return nullptr;
+			machine->actions[state].push_back(action);
+		} else if (kind == "COUNT") {
+			TableAction action;
+			action.kind = COUNT_ACTION;
+			action.file = -1;
+			if (!(in >> name >> action.counted >> action.histogram)) return nullptr;
+			int state = machine->stateOf(name);
+			if (state < 0) return nullptr;
+			machine->actions[state].push_back(action);
+		} else if (kind == "START") {
+			if (!(in >> name)) return nullptr;
+			machine->start = machine->stateOf(name);
+		} else if (kind == "SUMMARY") {
+			if (!(in >> name)) return nullptr;
+			machine->json = name == "json";
+		} else {
+			return nullptr;
+		}
+	}
+
+	if (machine->start < 0) return nullptr;
+	return machine;
+}
+
+shared_ptr<const Machine> current;
+atomic<unsigned> generation{0};
+
+// Lets the watcher sleep between polls and be woken to stop
+mutex watching;
+condition_variable wakeWatcher;
+bool stopping = false;
+
+// Polls the table file and publishes its tables whenever it is replaced or modified, until asked to stop
+void watch(string path) {
+	struct stat last;
+	if (stat(path.c_str(), &last) < 0) memset(&last, 0, sizeof(last));
+
+	for (;;) {
+		{
+			unique_lock<mutex> lock(watching);
+			if (wakeWatcher.wait_for(lock, chrono::milliseconds(200), [] { return stopping; })) return;
+		}
+
+		struct stat info;
+		if (stat(path.c_str(), &info) < 0) continue;
+		if (info.st_ino == last.st_ino && info.st_size == last.st_size &&
+			info.st_mtim.tv_sec == last.st_mtim.tv_sec && info.st_mtim.tv_nsec == last.st_mtim.tv_nsec) continue;
+		last = info;
+
+		shared_ptr<const Machine> machine = load(path);
+		if (!machine) {
+			cerr << "Could not reload machine tables from '" << path << "'\n";
+			continue;
+		}
+		atomic_store(&current, machine);
+		generation.fetch_add(1, memory_order_release);
+	}
+}
+
+// Stops the given watcher thread and waits for it, so it never outlives the tables it publishes
+void stopWatching(thread& watcher) {
+	{
+		lock_guard<mutex> lock(watching);
+		stopping = true;
+	}
+	wakeWatcher.notify_one();
+	watcher.join();
+}
+
+// Output files of the running machine; files stay open across reloads
+class Sinks {
+	map<string, ofstream*> open;
+public:
+	vector<ostream*> files;
+
+	void bind(const Machine& machine) {
+		files.clear();
+		for (const string& path : machine.filePaths) {
+			if (!open.count(path)) open[path] = new ofstream(path, ios::out | ios::app);
+			files.push_back(open[path]);
+		}
+	}
+	void close() {
+		for (pair<const string, ofstream*>& file : open) delete file.second;
+		open.clear();
+	}
+};
+
+map<string, unsigned long long> counts;
+map<string, map<string, unsigned long long>> histograms;
+
+void runActions(const Machine& machine, int state, const string& in, Sinks& sinks) {
+	for (const TableAction& action : machine.actions[state]) {
+		if (action.kind == COUNT_ACTION) {
+			++counts[action.counted];
+			if (action.histogram) ++histograms[action.counted][in];
+			continue;
+		}
+		ostream& out = action.kind == PRINT_ACTION ? cout : *sinks.files[action.file];
+		for (size_t i = 0; i < action.fragments.size(); ++i) {
+			if (i > 0) out << in;
+			out << action.fragments[i];
+		}
+	}
+}
+
+// Returns the total of every counted state; maps keep states and inputs sorted
+vector<Total> totals() {
+	vector<Total> all;
+	for (const pair<const string, unsigned long long>& count : counts) {
+		const map<string, unsigned long long>& histogram = histograms[count.first];
+		all.push_back(Total{ count.first, count.second, vector<pair<string, unsigned long long>>(histogram.begin(), histogram.end()) });
+	}
+	return all;
+}
+
+// Runs the machine in the given table file over tokens read from the given stream
+int interpret(const string& path, istream& input, char delimiter) {
+	shared_ptr<const Machine> machine = load(path);
+	if (!machine) {
+		cerr << "Could not load machine tables from '" << path << "'\n";
+		return 1;
+	}
+	atomic_store(&current, machine);
+	thread watcher(watch, path);
+
+	unsigned seen = 0;
+	Sinks sinks;
+	sinks.bind(*machine);
+
+	string in;
+	int state = machine->start;
+	for (;;) {
+		runActions(*machine, state, in, sinks);
+		if (!getline(input, in, delimiter)) break;
+
+		// Swap in reloaded tables between inputs, carrying the current state over by name
+		unsigned latest = generation.load(memory_order_acquire);
+		if (latest != seen) {
+			seen = latest;
+			string name = machine->names[state];
+			machine = atomic_load(&current);
+			state = machine->stateOf(name);
+			if (state < 0) state = machine->start;
+			sinks.bind(*machine);
+		}
+
+		state = machine->next[state][machine->symbolOf(in)];
+		if (state < 0) break;
+	}
+
+	stopWatching(watcher);
+
+	if (!counts.empty()) writeSummary(cout, totals(), machine->json);
+	sinks.close();
+	return 0;
+}
+}
+)";
+
+	// Reads several input sources at once. Pipes, terminals and sockets are waited on with epoll; regular files
+	// cannot be polled and are always ready, so they are read a chunk per turn between polls. Each source keeps
+	// its own buffer, and tokens are queued as soon as their delimiter arrives
+	const char* MULTIPLEXED_INPUT = R"(namespace statert {
+// Input source with the bytes of its unfinished token
+struct Source {
+	int fd;
+	string name;
+	char delimiter;
+	int flags;
+	bool pollable;
+	bool fifo;
+	bool open;
+	string buffer;
+	size_t start;
+};
+
+class Multiplexer {
+	static const int EVENTS = 16;
+	vector<Source> sources;
+	deque<pair<string, int>> tokens;
+	int epoll;
+	int remaining = 0;
+
+	// Queues every complete token in the buffer of the given source, searching only bytes that just arrived
+	void cut(int i, size_t from) {
+		Source& s = sources[i];
+		size_t end;
+		while ((end = s.buffer.find(s.delimiter, from)) != string::npos) {
+			tokens.emplace_back(s.buffer.substr(s.start, end - s.start), i);
+			s.start = from = end + 1;
+		}
+
+		// Drop consumed bytes once they outweigh the unfinished token
+		if (s.start * 2 >= s.buffer.size()) {
+			s.buffer.erase(0, s.start);
+			s.start = 0;
+		}
+	}
+
+	// Queues the last token of an exhausted source and stops watching it
+	void finish(int i) {
+		Source& s = sources[i];
+
+		// Like getline, a final token without a delimiter still counts
+		if (s.start < s.buffer.size()) tokens.emplace_back(s.buffer.substr(s.start), i);
+		s.buffer.clear();
+
+		if (s.pollable) epoll_ctl(epoll, EPOLL_CTL_DEL, s.fd, nullptr);
+		fcntl(s.fd, F_SETFL, s.flags);
+		if (s.fd != 0) close(s.fd);
+
+		s.open = false;
+		--remaining;
+	}
+
+	// Reads one chunk from the given source without blocking. A FIFO reads nothing until its first writer
+	// connects, so it only ends once epoll reports that its writers hung up
+	void fill(int i, bool hangup) {
+		static char chunk[1 << 16];
+		Source& s = sources[i];
+
+		for (;;) {
+			ssize_t n = read(s.fd, chunk, sizeof(chunk));
+			if (n > 0) {
+				size_t from = s.buffer.size();
+				s.buffer.append(chunk, n);
+				cut(i, from);
+			} else if (n < 0 && errno == EINTR) {
+				continue;
+			} else if (n == 0 && s.fifo && !hangup) {
+				// No writer yet; wait for one
+			} else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+				finish(i);
+			}
+			return;
+		}
+	}
+public:
+	Multiplexer() { epoll = epoll_create1(0); }
+
+	// Puts descriptors back the way they were found, since standard input outlives the program
+	~Multiplexer() {
+		for (Source& s : sources) {
+			if (s.open) fcntl(s.fd, F_SETFL, s.flags);
+		}
+		close(epoll);
+	}
+
+	// Adds a source split at the given delimiter. Terminals share their open file with standard output, so
+	// they are left blocking; epoll only reports them once a read will not block. Returns false if the source
+	// could not be opened
+	bool add(int fd, const char* name, char delimiter) {
+		if (fd < 0) {
+			cerr << "Input source '" << name << "' could not be opened\n";
+			return false;
+		}
+
+		Source s;
+		s.fd = fd;
+		s.name = name;
+		s.delimiter = delimiter;
+		s.flags = fcntl(fd, F_GETFL);
+		s.open = true;
+		s.start = 0;
+
+		struct stat info;
+		s.fifo = fstat(fd, &info) == 0 && S_ISFIFO(info.st_mode);
+		if (!isatty(fd)) fcntl(fd, F_SETFL, s.flags | O_NONBLOCK);
+
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.u32 = sources.size();
+		s.pollable = epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+
+		sources.push_back(s);
+		++remaining;
+		return true;
+	}
+
+	// Gets the next complete token and the name of its source. Returns false once every source is exhausted
+	bool next(string& token, string& source) {
+		while (tokens.empty()) {
+			if (remaining == 0) return false;
+
+			// Open files are always ready, so only wait for polled sources when no file is left
+			bool filesOpen = false;
+			for (Source& s : sources) filesOpen |= s.open && !s.pollable;
+
+			struct epoll_event events[EVENTS];
+			int count = epoll_wait(epoll, events, EVENTS, filesOpen ? 0 : -1);
+			if (count < 0 && errno != EINTR) return false;
+
+			for (int i = 0; i < count; ++i) {
+				if (sources[events[i].data.u32].open) fill(events[i].data.u32, events[i].events & EPOLLHUP);
+			}
+
+			for (size_t i = 0; i < sources.size(); ++i) {
+				if (sources[i].open && !sources[i].pollable) fill(i, false);
+			}
+		}
+
+		token = move(tokens.front().first);
+		source = sources[tokens.front().second].name;
+		tokens.pop_front();
+		return true;
+	}
+};
+Multiplexer input;
+}
+)";
+}
\ No newline at end of file
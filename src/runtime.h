@@ -0,0 +1,19 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+// Namespace wrapping support code emitted into compiled programs
+#define RUNTIME_NAMESPACE "statert"
+
+// Support code that is copied verbatim into compiled programs
+namespace Runtime {
+	extern const char* ASYNC_OUTPUT;
+	extern const char* SUMMARY_WRITER;
+	extern const char* COUNT_SUMMARY;
+	extern const char* LAZY_DFA;
+	extern const char* PROFILE_WRITER;
+	extern const char* CORPUS_READER;
+	extern const char* TABLE_INTERPRETER;
+	extern const char* MULTIPLEXED_INPUT;
+}
+
+#endif
@@ -1,14 +1,48 @@
 #include "writer.h"
 
 // Takes path to target file and pointers to parsed data
-Writer::Writer(string p, map<string, string>* f, map<string, string>* i, map<string, map<string, string>>* s, map<string, vector<Action>>* oa, Action* ia, string fs) {
+Writer::Writer(string p, map<string, string>* f, map<string, string>* i, map<string, map<string, string>>* s, map<string, vector<Action>>* oa, vector<Action>* ia, string fs, string sf, Nfa* n, Options* o) {
 	this->f.open(p);
 	files = f;
 	inputs = i;
 	states = s;
 	outputActions = oa;
-	inputAction = ia;
+	inputActions = ia;
+	multiplexed = ia->size() > 1;
 	firstState = fs;
+	summaryFormat = sf;
+	nfa = n;
+	options = o;
+	profilePath = p.substr(0, p.find_last_of(".")) + PROFILE_EXTENSION;
+	tablePath = p.substr(0, p.find_last_of(".")) + TABLE_EXTENSION;
+
+	// Lay states out in name order, or hottest first when given a profile
+	for (pair<string, map<string, string>> state : *states) stateOrder.push_back(state.first);
+
+	if (!options->profileUse.empty()) {
+		profile.load(options->profileUse);
+		stable_sort(stateOrder.begin(), stateOrder.end(), [this](string a, string b) {
+			return profile.visitsOf(a) > profile.visitsOf(b);
+		});
+	}
+
+	// Collect counted states so each gets a counter slot, and check whether any action reads IN or SRC
+	usesIn = false;
+	usesSrc = false;
+	set<string> writtenFiles;
+	for (pair<string, vector<Action>> stateActions : *outputActions) {
+		for (Action a : stateActions.second) {
+			if (a.name == COUNT && counterIndex(a.identifier) < 0) countedStates.push_back(a.identifier);
+			if (a.name == WRITE) writtenFiles.insert(a.identifier);
+			if (a.arg.find(IN_MARKER) != string::npos) usesIn = true;
+			if (a.arg.find(SRC_MARKER) != string::npos) usesSrc = true;
+		}
+	}
+
+	// Files that are only read are opened for reading alone, so pipes and FIFOs see their writers close
+	for (Action a : *inputActions) {
+		if (a.name == READ && !writtenFiles.count(a.identifier)) readOnlyFiles.insert(a.identifier);
+	}
 }
 
 // Closes file writer 
@@ -21,15 +55,170 @@ void Writer::writeIncludes() {
 	f << "#include<iostream>\n"
 	   	 "#include<fstream>\n"
 	     "#include<string>\n"
-	     "using namespace std;\n";
+	     "#include<unordered_map>\n";
+
+	// Summaries need histogram maps and sorting
+	if (!countedStates.empty()) {
+		f << "#include<vector>\n"
+		     "#include<algorithm>\n";
+	}
+
+	// Profiles may be written to a path given in the environment
+	if (options->profileGen) f << "#include<cstdlib>\n";
+
+	// Byte tables need fixed-width types
+	if (options->byteLevel) f << "#include<cstdint>\n";
+
+	// Corpus input maps the corpus file
+	if (options->corpusInput) {
+		f << "#include<cstdint>\n"
+		     "#include<cstring>\n"
+		     "#include<vector>\n"
+		     "#include<fcntl.h>\n"
+		     "#include<unistd.h>\n"
+		     "#include<sys/mman.h>\n"
+		     "#include<sys/stat.h>\n";
+	}
+
+	// Lazy DFA needs bitsets and its state cache
+	if (nfa->lazy) {
+		f << "#include<cstdint>\n"
+		     "#include<vector>\n"
+		     "#include<map>\n";
+	}
+
+	// Async output needs threads, atomics, condition variables and POSIX vectored writes
+	if (options->asyncOutput) {
+		f << "#include<thread>\n"
+		     "#include<atomic>\n"
+		     "#include<mutex>\n"
+		     "#include<condition_variable>\n"
+		     "#include<cerrno>\n"
+		     "#include<fcntl.h>\n"
+		     "#include<unistd.h>\n"
+		     "#include<sys/uio.h>\n";
+	}
+
+	// Multiplexed input polls its sources with epoll
+	if (multiplexed) {
+		f << "#include<vector>\n"
+		     "#include<deque>\n"
+		     "#include<cerrno>\n"
+		     "#include<fcntl.h>\n"
+		     "#include<unistd.h>\n"
+		     "#include<sys/epoll.h>\n"
+		     "#include<sys/stat.h>\n";
+	}
+
+	f << "using namespace std;\n";
+}
+
+// Writes support code needed by the selected compile options
+void Writer::writeRuntime() {
+	if (options->asyncOutput) f << Runtime::ASYNC_OUTPUT;
+
+	if (!countedStates.empty()) {
+		declareCounters();
+		f << Runtime::SUMMARY_WRITER;
+		f << Runtime::COUNT_SUMMARY;
+	}
+
+	declareAlphabet();
+
+	// Corpora are checked against the layout statec --tokenize writes
+	if (options->corpusInput) {
+		f << "namespace " RUNTIME_NAMESPACE " {\n"
+		     "const char CORPUS_MAGIC[] = \"" CORPUS_MAGIC "\";\n"
+		     "const uint32_t CORPUS_VERSION = " << CORPUS_VERSION << ";\n"
+		     "}\n";
+		f << Runtime::CORPUS_READER;
+	}
+
+	if (multiplexed) f << Runtime::MULTIPLEXED_INPUT;
+
+	if (nfa->lazy) {
+		declareNfaTables();
+		f << Runtime::LAZY_DFA;
+	}
+
+	if (options->profileGen) {
+		declareProfileCounters();
+		f << Runtime::PROFILE_WRITER;
+	}
+}
+
+// Declares counters of state visits and transition hits recorded for profiles
+void Writer::declareProfileCounters() {
+	f << "namespace " RUNTIME_NAMESPACE " {\n"
+	     "const char* PROFILE_ENV = \"" PROFILE_ENV "\";\n"
+	     "const int STATE_COUNT = " << stateOrder.size() + 1 << ";\n"
+	     "const int SYMBOL_COUNT = " << symbols.size() << ";\n"
+	     "const char* stateNames[STATE_COUNT] = {";
+
+	// States are named in enum order
+	for (string state : stateOrder) f << "\"" << state << "\", ";
+	f << "\"" END_STATE "\"};\n";
+
+	// Each symbol is recorded under the first input in it
+	f << "const char* symbolNames[SYMBOL_COUNT] = {\"" DEFAULT_INPUT "\"";
+	for (size_t i = 1; i < symbols.size(); ++i) f << ", \"" << symbols[i][0] << "\"";
+	f << "};\n"
+	     "unsigned long long visits[STATE_COUNT];\n"
+	     "unsigned long long hits[STATE_COUNT][SYMBOL_COUNT];\n"
+	     "}\n";
+}
+
+// Returns number of times the given state received an input in the given symbol according to the profile
+unsigned long long Writer::symbolHits(string state, int symbol) {
+	if (symbol == 0) return profile.hitsOf(state, DEFAULT_INPUT);
+
+	unsigned long long total = 0;
+	for (string input : symbols[symbol]) total += profile.hitsOf(state, input);
+
+	return total;
+}
+
+// Returns index of the counter for the given state, or -1 if it is not counted
+int Writer::counterIndex(string state) {
+	for (size_t i = 0; i < countedStates.size(); ++i) {
+		if (countedStates[i] == state) return i;
+	}
+	return -1;
+}
+
+// Declares per-state entry counters and $in histograms used by COUNT
+void Writer::declareCounters() {
+	f << "namespace " RUNTIME_NAMESPACE " {\n"
+	     "const int COUNTED = " << countedStates.size() << ";\n"
+	     "const char* countedNames[COUNTED] = {";
+
+	for (size_t i = 0; i < countedStates.size(); ++i) {
+		if (i > 0) f << ", ";
+		f << "\"" << countedStates[i] << "\"";
+	}
+
+	f << "};\n"
+	     "unsigned long long counts[COUNTED];\n"
+	     "unordered_map<string, unsigned long long> histograms[COUNTED];\n"
+	     "}\n";
+}
+
+// Writes emission of COUNT totals in the selected summary format
+void Writer::writeSummary() {
+	if (countedStates.empty()) return;
+
+	f << "\t" RUNTIME_NAMESPACE "::writeSummary(cout, " RUNTIME_NAMESPACE "::totals(), " << (summaryFormat == SUMMARY_JSON ? "true" : "false") << ");\n";
 }
 
 // Declares enum for states in target file
 void Writer::declareStates() {
+	// Lazy DFA tracks states by index instead
+	if (nfa->lazy) return;
+
 	// Write enum for state
 	f << "enum State {\n";
-	for (pair<string, map<string, string>> state : *states) {
-		f << "\t" << state.first << ",\n";
+	for (string state : stateOrder) {
+		f << "\t" << state << ",\n";
 	}
 
 	// Write built-in END state
@@ -42,74 +231,328 @@ void Writer::declareStates() {
 void Writer::writeFileDeclarations() {
 	// Iterate through files and write each one as an f stream
 	for (pair<string, string> file : *files) {
+		// Multiplexed sources are read through their own descriptor; a single source only needs an ifstream
+		if (readOnlyFiles.count(file.first)) {
+			if (multiplexed) continue;
+
+			f << "\tifstream " << file.first << "(\"" << file.second << "\");\n"
+			     "\tif (!" << file.first << ") {\n"
+			     "\t\tcerr << \"Input source '" << file.first << "' could not be opened\\n\";\n"
+			     "\t\treturn 1;\n"
+			     "\t}\n";
+			continue;
+		}
+
 		// Declare current file as fstream object
 		f << "\tfstream " << file.first << "(\"" << file.second << "\", fstream::in | fstream::out | fstream::app);\n";
+
+		// Async output writes to a raw descriptor instead of the fstream
+		if (options->asyncOutput)
+			f << "\tint " << file.first << "_fd = open(\"" << file.second << "\", O_WRONLY | O_CREAT | O_APPEND, 0644);\n";
+	}
+
+	// Start writer thread once all sinks are open
+	if (options->asyncOutput) f << "\t" RUNTIME_NAMESPACE "::ring.start();\n";
+}
+
+// Writes declaration of SRC and, for multiplexed input, registration of every source with the event loop
+void Writer::writeSourceDeclarations() {
+	// With a single source SRC never changes
+	if (!multiplexed) {
+		if (usesSrc) f << "\tconst string " SRC " = \"" << inputActions->front().identifier << "\";\n";
+		return;
+	}
+
+	f << "\tstring " SRC ";\n";
+
+	for (Action a : *inputActions) {
+		// Standard input is already open; files get their own read-only descriptor, opened without blocking so a
+		// FIFO with no writer yet does not hold up the other sources
+		string descriptor = a.name == SCAN ? "0" : "open(\"" + files->operator[](a.identifier) + "\", O_RDONLY | O_NONBLOCK)";
+		f << "\tif (!" RUNTIME_NAMESPACE "::input.add(" << descriptor << ", \"" << a.identifier << "\", '" << a.arg << "')) return 1;\n";
 	}
 }
 
 // Writes main function and state change logic
 void Writer::writeLogic() {
+	// Byte-level machines scan raw input instead of splitting it
+	if (options->byteLevel) {
+		writeByteLogic();
+		return;
+	}
+
 	// Write beginning of main function and IN declaration
-	f << "int main() {\n"
-		 "\tstring " IN ";\n";
+	if (options->corpusInput) f << "int main(int argc, char* argv[]) {\n";
+	else f << "int main() {\n";
 
-	// Write declaration of file objects
+	f << "\tstring " IN ";\n";
+
+	// Map corpus given as the first argument
+	if (options->corpusInput) {
+		// Delimiter is shown as written in source, so its escape characters are escaped again inside the message
+		string shownDelimiter;
+		for (char c : inputActions->front().arg) {
+			if (c == '\\' || c == '"') shownDelimiter += '\\';
+			shownDelimiter += c;
+		}
+
+		f << "\tif (argc < 2 || !" RUNTIME_NAMESPACE "::corpus.open(argv[1], '" << inputActions->front().arg << "')) {\n"
+		     "\t\tcerr << \"Please provide a corpus tokenized at '" << shownDelimiter << "'\\n\";\n"
+		     "\t\treturn 1;\n"
+		     "\t}\n";
+	}
+
+	// Register input sources before opening sinks, so a missing source exits before the writer thread starts
+	writeSourceDeclarations();
 	writeFileDeclarations();
 
-	// Declare input variable, do-while loop opening and first switch statement
-	f  << "\tState " STATE " = " << firstState << ";\n"
-	 	  "\tdo { \n"
-		  "\t\tswitch" "(" STATE ") {\n";
+	// Declare state variable and open the stepping loop
+	if (nfa->lazy) f << "\tint " STATE " = " RUNTIME_NAMESPACE "::dfa.start();\n";
+	else f << "\tState " STATE " = " << firstState << ";\n";
 
-	// Flag to determine if "if" should be written
-	bool writeIf;
+	f << "\tfor (;;) {\n";
+
+	// Run actions of the current state; the first state's run once before any input is read
+	if (nfa->lazy) writeLazyActions();
+	else writeActions();
+
+	// Stop once END is reached or input runs out
+	if (nfa->lazy) f << "\t\tif (" RUNTIME_NAMESPACE "::dfa.ended(" STATE ") || !";
+	else f << "\t\tif (" STATE " == " END_STATE " || !";
+	writeInputAction();
+
+	f << ") break;\n";
+
+	// Corpus tokens are only copied out when actions use them
+	if (options->corpusInput && usesIn) f << "\t\t" RUNTIME_NAMESPACE "::corpus.text(" IN ");\n";
+
+	// Switch states on the new input
+	if (nfa->lazy) f << "\t\t" STATE " = " RUNTIME_NAMESPACE "::dfa.step(" STATE ", " << symbolExpression() << ");\n";
+	else writeTransitions();
+
+	// Close loop
+	f << "\t}\n";
+
+	// Drain outstanding output before closing sinks
+	if (options->asyncOutput) f << "\t" RUNTIME_NAMESPACE "::ring.finish();\n";
+
+	// Emit totals once all other output is out
+	writeSummary();
+
+	// Save recorded profile
+	if (options->profileGen) f << "\t" RUNTIME_NAMESPACE "::writeProfile(\"" << profilePath << "\");\n";
+
+	// Close files
+	writeFileCloses();
+
+	// Write closing for main function
+	f << "\treturn 0;\n}";
+}
+
+// Returns the state the given DFA state moves to on the given input
+string Writer::targetOf(string state, string input) {
+	map<string, string> &transitions = states->operator[](state);
+
+	// Inputs not listed take the default transition, or loop back to the state itself
+	if (transitions.count(input)) return transitions[input];
+	if (transitions.count(DEFAULT_INPUT)) return transitions[DEFAULT_INPUT];
+
+	return state;
+}
+
+// Groups inputs into symbols. Inputs that move every state to the same place share a symbol, so transition rows
+// only need one case per distinct behavior. Symbol 0 stands for every input that behaves like an unlisted one
+void Writer::buildAlphabet() {
+	symbols.assign(1, vector<string>());
+
+	if (nfa->lazy) {
+		// The lazy DFA is built from NFA tables, which keep one symbol per input
+		for (string input : nfa->symbols()) symbols.push_back({ input });
+	} else {
+		// Maps the targets of an input in every state to its symbol
+		map<vector<string>, int> symbolOfTargets;
+
+		// Targets of each state in name order
+		vector<string> targets;
+
+		for (pair<string, map<string, string>> state : *states) targets.push_back(targetOf(state.first, DEFAULT_INPUT));
+		symbolOfTargets[targets] = 0;
+
+		for (pair<string, string> input : *inputs) {
+			targets.clear();
+			for (pair<string, map<string, string>> state : *states) targets.push_back(targetOf(state.first, input.first));
+
+			if (!symbolOfTargets.count(targets)) {
+				symbolOfTargets[targets] = symbols.size();
+				symbols.push_back(vector<string>());
+			}
+
+			symbols[symbolOfTargets[targets]].push_back(input.first);
+		}
+
+		// Give the most received symbols the lowest numbers
+		if (!profile.empty()) {
+			map<vector<string>, unsigned long long> totals;
+			for (size_t i = 1; i < symbols.size(); ++i) {
+				for (string state : stateOrder) totals[symbols[i]] += symbolHits(state, i);
+			}
+
+			stable_sort(symbols.begin() + 1, symbols.end(), [&totals](const vector<string> &a, const vector<string> &b) {
+				return totals[a] > totals[b];
+			});
+		}
+	}
+}
+
+// Declares the lookup from input strings to symbols
+void Writer::declareAlphabet() {
+	buildAlphabet();
+
+	// Map input strings to symbols; strings not in the map are symbol 0
+	f << "namespace " RUNTIME_NAMESPACE " {\n"
+	     "const unordered_map<string, int> symbolIds = {";
+
+	bool first = true;
+	for (size_t i = 1; i < symbols.size(); ++i) {
+		for (string input : symbols[i]) {
+			if (!first) f << ", ";
+			f << "{\"" << inputs->operator[](input) << "\", " << i << "}";
+			first = false;
+		}
+	}
+
+	f << "};\n"
+	     "int symbolOf(const string& in) {\n"
+	     "\tunordered_map<string, int>::const_iterator it = symbolIds.find(in);\n"
+	     "\treturn it == symbolIds.end() ? 0 : it->second;\n"
+	     "}\n"
+	     "}\n";
+}
+
+// Writes switch statement changing states on the symbol of IN
+void Writer::writeTransitions() {
+	// Record which transition is taken before taking it
+	if (options->profileGen) f << "\t\t++" RUNTIME_NAMESPACE "::hits[" STATE "][" << symbolExpression() << "];\n";
+
+	f << "\t\tswitch(" STATE ") {\n";
 
 	// Write case for each state to switch states
-	for (pair<string, map<string, string>> state : *states) {
+	for (string state : stateOrder) {
+		// State unlisted inputs move to
+		string defaultTarget = targetOf(state, DEFAULT_INPUT);
+
+		// Maps target states to the symbols that move to them, leaving out ones that match the default
+		map<string, vector<int>> symbolsByTarget;
+		for (size_t i = 1; i < symbols.size(); ++i) {
+			string target = targetOf(state, symbols[i][0]);
+			if (target != defaultTarget) symbolsByTarget[target].push_back(i);
+		}
+
 		// If no transition, do not write the state transition logic for this state
-		if (state.second.count("")) continue;
+		if (symbolsByTarget.empty() && defaultTarget == state) continue;
 
-		f << "\t\tcase " << state.first << ":\n";
+		f << "\t\tcase " << state << ":";
 
-		writeIf = true;
+		// Profiled states test their most taken transitions first
+		if (!profile.empty()) {
+			writeProfiledTransitions(state, defaultTarget, symbolsByTarget);
+			continue;
+		}
 
-		// Write if/else for each transition to change state
-		for (pair<string, string> trans : state.second) {
-			// Write if/else if branch
-			if (writeIf) {
-				f << "\t\t\tif(";
-				writeIf =  false;
-			} else {
-				f<< "\t\t\telse if(";
-			}
+		f << "\n"
+		     "\t\t\tswitch(" << symbolExpression() << ") {\n";
 
-			// Write condition to determine which input is currently being analyzed
-			f << IN " == \"" << inputs->operator[](trans.first) << "\") {\n";
-			
-			// Write state transition logic
-			f << "\t\t\t\t" STATE " = "<< trans.second << ";\n";
+		// Write one case list per target state
+		for (pair<string, vector<int>> target : symbolsByTarget) {
+			f << "\t\t\t";
+			for (int symbol : target.second) f << "case " << symbol << ": ";
+			f << "\n";
 
-			// Close if statement
-			f << "\t\t\t}\n";
+			// Symbols looping back to the state only need to skip the default
+			if (target.first != state) f << "\t\t\t\t" STATE " = " << target.first << ";\n";
+
+			f << "\t\t\t\tbreak;\n";
 		}
 
-		f << "\t\t\tbreak;\n";
+		// Write default transition
+		if (defaultTarget != state) {
+			f << "\t\t\tdefault:\n"
+			     "\t\t\t\t" STATE " = " << defaultTarget << ";\n";
+		}
+
+		f << "\t\t\t}\n"
+		     "\t\t\tbreak;\n";
 	}
+
 	// Close switch
-	f << "\t\t}\n";
+	f << "\t\tdefault:\n"
+	     "\t\t\tbreak;\n"
+	     "\t\t}\n";
+}
+
+// Writes the body of a state's transition case as an if/else chain testing targets in order of profiled hits,
+// with the default transition last
+void Writer::writeProfiledTransitions(string state, string defaultTarget, map<string, vector<int>> &symbolsByTarget) {
+	// Targets with their total hits
+	vector<pair<unsigned long long, string>> targets;
+	for (pair<string, vector<int>> target : symbolsByTarget) {
+		unsigned long long hits = 0;
+		for (int symbol : target.second) hits += symbolHits(state, symbol);
+		targets.push_back(make_pair(hits, target.first));
+	}
+
+	// Most hit first; ties keep name order
+	stable_sort(targets.begin(), targets.end(), [](const pair<unsigned long long, string> &a, const pair<unsigned long long, string> &b) {
+		return a.first > b.first;
+	});
+
+	f << " {\n";
+
+	// Only look input up if there is something to test
+	if (!targets.empty()) f << "\t\t\tint symbol = " << symbolExpression() << ";\n";
+
+	// Flag to determine if "if" should be written
+	bool writeIf = true;
+
+	for (pair<unsigned long long, string> target : targets) {
+		vector<int> &targetSymbols = symbolsByTarget[target.second];
+
+		f << (writeIf ? "\t\t\tif(" : "\t\t\telse if(");
+		writeIf = false;
+
+		for (size_t i = 0; i < targetSymbols.size(); ++i) f << (i > 0 ? " || " : "") << "symbol == " << targetSymbols[i];
+
+		// Symbols looping back to the state only need to skip the default
+		if (target.second == state) f << ") {}\n";
+		else f << ") " STATE " = " << target.second << ";\n";
+	}
+
+	// Write default transition
+	if (defaultTarget != state) {
+		if (writeIf) f << "\t\t\t" STATE " = " << defaultTarget << ";\n";
+		else f << "\t\t\telse " STATE " = " << defaultTarget << ";\n";
+	}
+
+	f << "\t\t\tbreak;\n"
+	     "\t\t}\n";
+}
+
+// Writes switch statement running the actions of the current state
+void Writer::writeActions() {
+	// Record visit to the current state
+	if (options->profileGen) f << "\t\t++" RUNTIME_NAMESPACE "::visits[" STATE "];\n";
 
-	// Write second switch statement to execute actions
 	f << "\t\tswitch(" STATE ") {\n";
 
 	// Actions currently being written at any point in the action-writing loop
 	vector<Action> currentActions;
 
 	// Write case for each state to write actions
-	for (pair<string, map<string, string>> state : *states) {
-		f << "\t\tcase " << state.first << ":\n";
+	for (string state : stateOrder) {
+		f << "\t\tcase " << state << ":\n";
 
 		// Get output actions associated with this state
-		currentActions = outputActions->operator[](state.first);
+		currentActions = outputActions->operator[](state);
 
 		// Iterate through actions and write them
 		for (Action a : currentActions) {
@@ -124,14 +567,191 @@ void Writer::writeLogic() {
 		f << "\t\t\tbreak;\n";
 	}
 
-	// Close second switch block
-	f << "\t\t}\n";
+	// Close switch block
+	f << "\t\tdefault:\n"
+	     "\t\t\tbreak;\n"
+	     "\t\t}\n";
+}
 
-	// Write do-while condition
-	f << "\t} while(state != " << END_STATE " && ";
-	writeInputAction();
+// Declares NFA tables the lazy DFA is built from. Each (state, symbol) pair maps to the epsilon closure of the
+// states it moves to, stored as a slice of MOVE_TARGETS
+void Writer::declareNfaTables() {
+	// Index NFA states in name order with END last
+	nfaStates.clear();
+	for (pair<string, map<string, set<string>>> state : nfa->transitions) nfaStates.push_back(state.first);
+	nfaStates.push_back(END_STATE);
+
+	map<string, int> index;
+	for (size_t i = 0; i < nfaStates.size(); ++i) index[nfaStates[i]] = i;
+
+	f << "namespace " RUNTIME_NAMESPACE " {\n"
+	     "const int NFA_STATES = " << nfaStates.size() << ";\n"
+	     "const int END_INDEX = " << nfaStates.size() - 1 << ";\n"
+	     "const int SYMBOLS = " << symbols.size() << ";\n"
+	     "const size_t CACHE_LIMIT = " << options->dfaLimit << ";\n";
+
+	// Start set is the closure of the first state
+	f << "const int START[] = {";
+	bool first = true;
+	for (string state : nfa->closure({ firstState })) {
+		if (!first) f << ", ";
+		f << index[state];
+		first = false;
+	}
+	f << "};\n";
+
+	// Flattened closures of each move, and offsets of each (state, symbol) slice
+	vector<int> offsets;
+	vector<int> targets;
+	for (string state : nfaStates) {
+		for (size_t i = 0; i < symbols.size(); ++i) {
+			// Symbol 0 moves like inputs no transition lists
+			string input = i == 0 ? DEFAULT_INPUT : symbols[i][0];
+
+			offsets.push_back(targets.size());
+			for (string target : nfa->move({ state }, input)) targets.push_back(index[target]);
+		}
+	}
+	offsets.push_back(targets.size());
+
+	f << "const int MOVE_OFFSETS[] = {";
+	for (size_t i = 0; i < offsets.size(); ++i) f << (i > 0 ? ", " : "") << offsets[i];
+	f << "};\n"
+	     "const int MOVE_TARGETS[] = {";
+	for (size_t i = 0; i < targets.size(); ++i) f << (i > 0 ? ", " : "") << targets[i];
+	f << "};\n"
+	     "}\n";
+}
+
+
+// Writes loop running the actions of every NFA state in the current lazy DFA state. Like the END state, sets
+// containing END run no actions
+void Writer::writeLazyActions() {
+	f << "\t\tif (!" RUNTIME_NAMESPACE "::dfa.ended(" STATE ")) {\n"
+	     "\t\t\tfor (int nfaState : " RUNTIME_NAMESPACE "::dfa.members(" STATE ")) {\n"
+	     "\t\t\t\tswitch(nfaState) {\n";
+
+	// Write case for each NFA state with actions
+	for (size_t i = 0; i < nfaStates.size(); ++i) {
+		if (!outputActions->count(nfaStates[i])) continue;
+
+		f << "\t\t\t\tcase " << i << ":\n";
+
+		for (Action a : outputActions->operator[](nfaStates[i])) {
+			f << "\t\t\t\t\t";
+			writeOutputAction(a);
+			f << "\n";
+		}
+
+		f << "\t\t\t\t\tbreak;\n";
+	}
+
+	// Close switch, member loop and END check
+	f << "\t\t\t\t}\n"
+	     "\t\t\t}\n"
+	     "\t\t}\n";
+}
+
+// Declares tables of the byte-level product of an Aho-Corasick automaton over the input strings and the DFA
+void Writer::declareByteTables() {
+	// Input strings the automaton matches; empty inputs can never complete a match
+	vector<string> matches;
+	for (pair<string, string> input : *inputs) {
+		if (!input.second.empty() && find(matches.begin(), matches.end(), input.second) == matches.end())
+			matches.push_back(input.second);
+	}
+
+	// Target of every state on every input string
+	map<string, map<string, string>> targets;
+	for (pair<string, map<string, string>> state : *states) {
+		for (size_t i = 1; i < symbols.size(); ++i) {
+			for (string input : symbols[i]) {
+				string &target = targets[state.first][inputs->operator[](input)];
+				if (target.empty()) target = targetOf(state.first, input);
+			}
+		}
+
+		// Inputs sharing symbol 0 take the default transition
+		for (string match : matches) {
+			if (!targets[state.first].count(match)) targets[state.first][match] = targetOf(state.first, DEFAULT_INPUT);
+		}
+	}
+
+	ByteMachine machine;
+	machine.build(matches, targets, firstState, END_STATE);
+
+	// Use the narrowest type that can index every product state
+	string indexType = machine.next.size() <= 65536 ? "uint16_t" : "uint32_t";
+
+	f << "namespace " RUNTIME_NAMESPACE " {\n"
+	     "const char* const MATCHES[] = {";
+	for (size_t i = 0; i < matches.size(); ++i) f << (i > 0 ? ", " : "") << "\"" << matches[i] << "\"";
+	f << "};\n";
+
+	f << "const " << indexType << " NEXT[][" ALPHABET_SIZE_STRING "] = {\n";
+	for (vector<int> row : machine.next) {
+		f << "\t{";
+		for (int c = 0; c < ALPHABET_SIZE; ++c) f << (c > 0 ? "," : "") << row[c];
+		f << "},\n";
+	}
+	f << "};\n";
+
+	f << "const int MATCH[] = {";
+	for (size_t i = 0; i < machine.match.size(); ++i) f << (i > 0 ? ", " : "") << machine.match[i];
+	f << "};\n";
+
+	f << "const State MACHINE[] = {";
+	for (size_t i = 0; i < machine.machineStates.size(); ++i) f << (i > 0 ? ", " : "") << machine.machineStates[i];
+	f << "};\n"
+	     "}\n";
+}
+
+// Writes main function scanning raw input through the byte-level product machine. Actions run whenever an input
+// string is matched, with IN holding the matched string
+void Writer::writeByteLogic() {
+	declareByteTables();
+
+	// Streambuf raw input is read from
+	string location = inputActions->front().name == SCAN ? "cin" : inputActions->front().identifier;
+
+	f << "int main() {\n"
+	     "\tios::sync_with_stdio(false);\n"
+	     "\tstring " IN ";\n";
+
+	writeSourceDeclarations();
+	writeFileDeclarations();
+
+	f << "\tState " STATE " = " << firstState << ";\n"
+	     "\tint product = 0;\n"
+	     "\tstatic char buffer[1 << 16];\n"
+	     "\tstreamsize length = 0;\n"
+	     "\tstreamsize i = 0;\n"
+	     "\tfor (;;) {\n";
+
+	// Actions run for the first state, then once per match, like they run once per input in delimiter-split machines
+	writeActions();
 
-	f << ");\n";
+	// Scan raw bytes until an input string is matched or input runs out
+	f << "\t\tif (" STATE " == " END_STATE ") break;\n"
+	     "\t\tbool matched = false;\n"
+	     "\t\twhile (!matched) {\n"
+	     "\t\t\tif (i == length) {\n"
+	     "\t\t\t\tif ((length = " << location << ".rdbuf()->sgetn(buffer, sizeof(buffer))) <= 0) break;\n"
+	     "\t\t\t\ti = 0;\n"
+	     "\t\t\t}\n"
+	     "\t\t\tproduct = " RUNTIME_NAMESPACE "::NEXT[product][(unsigned char)buffer[i++]];\n"
+	     "\t\t\tmatched = " RUNTIME_NAMESPACE "::MATCH[product] >= 0;\n"
+	     "\t\t}\n"
+	     "\t\tif (!matched) break;\n"
+	     "\t\t" STATE " = " RUNTIME_NAMESPACE "::MACHINE[product];\n"
+	     "\t\t" IN " = " RUNTIME_NAMESPACE "::MATCHES[" RUNTIME_NAMESPACE "::MATCH[product]];\n"
+	     "\t}\n";
+
+	// Drain outstanding output before closing sinks
+	if (options->asyncOutput) f << "\t" RUNTIME_NAMESPACE "::ring.finish();\n";
+
+	// Emit totals once all other output is out
+	writeSummary();
 
 	// Close files
 	writeFileCloses();
@@ -140,69 +760,268 @@ void Writer::writeLogic() {
 	f << "\treturn 0;\n}";
 }
 
+// Writes the given string as its length, a colon and its bytes
+static void writeLengthPrefixed(ostream &out, string s) {
+	out << s.size() << ":" << s;
+}
+
+// Writes the machine as a table file read by table-driven programs. The file is written next to its final path
+// and renamed over it, so a running program never sees a partially written table
+void Writer::writeTables() {
+	buildAlphabet();
+
+	string temporaryPath = tablePath + ".tmp";
+	ofstream t(temporaryPath, ios::binary);
+
+	t << TABLE_MAGIC " " << TABLE_VERSION << "\n"
+	     "SYMBOLS " << symbols.size() << "\n";
+
+	for (pair<string, string> file : *files) {
+		t << FILE_TYPE " " << file.first << " ";
+		writeLengthPrefixed(t, ByteMachine::unescape(file.second));
+		t << "\n";
+	}
+
+	// Input strings are stored as the bytes they stand for
+	for (size_t i = 1; i < symbols.size(); ++i) {
+		for (string input : symbols[i]) {
+			t << "SYMBOL " << i << " ";
+			writeLengthPrefixed(t, ByteMachine::unescape(inputs->operator[](input)));
+			t << "\n";
+		}
+	}
+
+	for (string state : stateOrder) t << STATE_TYPE " " << state << "\n";
+
+	// Transitions that leave the state
+	for (string state : stateOrder) {
+		for (size_t i = 0; i < symbols.size(); ++i) {
+			string target = targetOf(state, i == 0 ? DEFAULT_INPUT : symbols[i][0]);
+			if (target != state) t << "TRANSITION " << state << " " << i << " " << target << "\n";
+		}
+	}
+
+	// Actions with their text split around each reference to IN. The only source is known now, so SRC is
+	// written into the text
+	vector<string> fragments;
+	vector<string> variables;
+	for (string state : stateOrder) {
+		for (Action a : outputActions->operator[](state)) {
+			if (a.name == COUNT) {
+				t << COUNT " " << state << " " << a.identifier << " " << (a.arg == IN_MARKER) << "\n";
+				continue;
+			}
+
+			t << a.name << " " << state << " ";
+			if (a.name == WRITE) t << a.identifier << " ";
+
+			string arg = a.arg;
+			for (size_t srcPos = arg.find(SRC_MARKER); srcPos != string::npos; srcPos = arg.find(SRC_MARKER, srcPos))
+				arg.replace(srcPos, string(SRC_MARKER).size(), inputActions->front().identifier);
+
+			splitMarkers(arg, fragments, variables);
+			t << fragments.size();
+			for (string fragment : fragments) {
+				t << " ";
+				writeLengthPrefixed(t, ByteMachine::unescape(fragment));
+			}
+			t << "\n";
+		}
+	}
+
+	t << "START " << firstState << "\n"
+	     SUMMARY " " << summaryFormat << "\n";
+
+	t.close();
+	rename(temporaryPath.c_str(), tablePath.c_str());
+}
+
+// Writes a program that runs the machine from its table file, reloading the table whenever it changes
+void Writer::writeTableProgram() {
+	f << "#include<iostream>\n"
+	     "#include<fstream>\n"
+	     "#include<string>\n"
+	     "#include<vector>\n"
+	     "#include<map>\n"
+	     "#include<unordered_map>\n"
+	     "#include<algorithm>\n"
+	     "#include<memory>\n"
+	     "#include<atomic>\n"
+	     "#include<thread>\n"
+	     "#include<mutex>\n"
+	     "#include<condition_variable>\n"
+	     "#include<chrono>\n"
+	     "#include<cstring>\n"
+	     "#include<cstdlib>\n"
+	     "#include<sys/stat.h>\n"
+	     "using namespace std;\n";
+
+	f << Runtime::SUMMARY_WRITER;
+	f << Runtime::TABLE_INTERPRETER;
+
+	f << "int main() {\n";
+
+	// READ opens its file for the lifetime of the program; later tables cannot change the input
+	Action &inputAction = inputActions->front();
+	string location = "cin";
+	if (inputAction.name == READ) {
+		location = inputAction.identifier;
+		f << "\tifstream " << location << "(\"" << files->operator[](location) << "\");\n"
+		     "\tif (!" << location << ") {\n"
+		     "\t\tcerr << \"Input source '" << location << "' could not be opened\\n\";\n"
+		     "\t\treturn 1;\n"
+		     "\t}\n";
+	}
+
+	// The table path is relative when the source path given to statec is, so it can be overridden at run time
+	f << "\tconst char* tables = getenv(\"" TABLE_ENV "\");\n"
+	     "\treturn " RUNTIME_NAMESPACE "::interpret(tables ? tables : \"" << tablePath << "\", " << location << ", '" << inputAction.arg << "');\n"
+	     "}";
+}
+
+// Returns expression compiled code uses to get the symbol of the current input
+string Writer::symbolExpression() {
+	// Corpus tokens were translated to symbols when the corpus was opened
+	if (options->corpusInput) return RUNTIME_NAMESPACE "::corpus.symbol";
+
+	return RUNTIME_NAMESPACE "::symbolOf(" IN ")";
+}
+
 // Writes the given input action
 void Writer::writeInputAction() {
+	// Corpus input walks the pre-tokenized IDs
+	if (options->corpusInput) {
+		f << RUNTIME_NAMESPACE "::corpus.next()";
+		return;
+	}
+
+	// Multiplexed input takes whichever source completes a token first
+	if (multiplexed) {
+		f << RUNTIME_NAMESPACE "::input.next(" IN ", " SRC ")";
+		return;
+	}
+
+	Action &inputAction = inputActions->front();
+
 	// String representation of where data should be input from
 	string location;
 
 	// If SCAN, read from cin
-	if (inputAction->name == SCAN) {
+	if (inputAction.name == SCAN) {
 		location = "cin";
 
 	// If READ, read from given file
 	} else {
-		location = inputAction->identifier;
+		location = inputAction.identifier;
 	}
 
 	// Write input
-	f << "getline(" << location << ", " IN ", '" << inputAction->arg << "')";
+	f << "getline(" << location << ", " IN ", '" << inputAction.arg << "')";
 }
 
-// Writes the given output action
-void Writer::writeOutputAction(Action action) {
-	// Get size of IN variable name
+// Splits the given action arg into the fragments surrounding each IN and SRC marker. The variable each marker
+// refers to is put in variables, between the fragments before and after it
+void Writer::splitMarkers(string arg, vector<string> &fragments, vector<string> &variables) {
+	// Get size of marker names
 	static const int IN_LEN = string(IN_MARKER).size();
+	static const int SRC_LEN = string(SRC_MARKER).size();
 
-	// Get position of first occurrence of the IN marker
-	size_t inPos = action.arg.find(IN_MARKER);
+	fragments.clear();
+	variables.clear();
+
+	// Position of the start of the current fragment
+	size_t start = 0;
+
+	// Cut a fragment before every occurrence of either marker
+	for (;;) {
+		size_t inPos = arg.find(IN_MARKER, start);
+		size_t srcPos = arg.find(SRC_MARKER, start);
+		if (inPos == string::npos && srcPos == string::npos) break;
+
+		if (inPos < srcPos) {
+			fragments.push_back(arg.substr(start, inPos - start));
+			variables.push_back(IN);
+			start = inPos + IN_LEN;
+		} else {
+			fragments.push_back(arg.substr(start, srcPos - start));
+			variables.push_back(SRC);
+			start = srcPos + SRC_LEN;
+		}
+	}
 
-	// Vector of positions in line where the in marker is used
-	vector<size_t> inReferences;
+	// Add fragment after the last reference
+	fragments.push_back(arg.substr(start));
+}
 
-	// Find all occurrences of the in marker in this action's arg
-	while (inPos != string::npos) {
-		// Add position of reference to list
-		inReferences.push_back(inPos);
+// Writes the given output action
+void Writer::writeOutputAction(Action action) {
+	// COUNT only bumps in-memory counters
+	if (action.name == COUNT) {
+		int index = counterIndex(action.identifier);
+		f << "++" RUNTIME_NAMESPACE "::counts[" << index << "];";
 
-		// Find next reference to the in marker
-		inPos = action.arg.substr(inPos + IN_LEN).find(IN_MARKER);
+		if (action.arg == IN_MARKER) f << " ++" RUNTIME_NAMESPACE "::histograms[" << index << "][" IN "];";
+		return;
 	}
 
-	// Replace each reference to in with the name of the in variable
-	for (int pos : inReferences) {
-		action.arg.replace(pos, IN_LEN, "\" << " IN " << \"");
+	// Fragments of arg between references to IN or SRC, and the variable referenced after each
+	vector<string> fragments;
+	vector<string> variables;
+	splitMarkers(action.arg, fragments, variables);
+
+	// Async output pushes each fragment and variable slice onto the output ring
+	if (options->asyncOutput) {
+		// Descriptor of the sink this action writes to
+		string sink = action.name == PRINT ? "1" : action.identifier + "_fd";
+
+		for (size_t i = 0; i < fragments.size(); ++i) {
+			// Reference to IN or SRC sits between each pair of fragments
+			if (i > 0) f << RUNTIME_NAMESPACE "::ring.push(" << sink << ", " << variables[i - 1] << "); ";
+
+			// Empty fragments would only cost a record
+			if (fragments[i].empty()) continue;
+
+			f << RUNTIME_NAMESPACE "::ring.push(" << sink << ", \"" << fragments[i] << "\", sizeof(\"" << fragments[i] << "\") - 1); ";
+		}
+		return;
 	}
 
 	// Write statement depending on which output action this line has
-	if (action.name == PRINT) {
-		f << "cout << \"" << action.arg << "\";";
-	} else {
-		f << action.identifier << " << \"" << action.arg << "\";";
+	if (action.name == PRINT) f << "cout";
+	else f << action.identifier;
+
+	for (size_t i = 0; i < fragments.size(); ++i) {
+		if (i > 0) f << " << " << variables[i - 1];
+		f << " << \"" << fragments[i] << "\"";
 	}
+
+	f << ";";
 }
 
 // Writes closing statements for ifstream
 void Writer::writeFileCloses() {
 	// Iterate through files and write closes for each one
 	for (pair<string, string> file : *files) {
-		// Declare current file as fstream object
+		// Multiplexed sources are closed by the event loop
+		if (readOnlyFiles.count(file.first) && multiplexed) continue;
+
 		f << "\t" << file.first << ".close();\n";
+
+		if (options->asyncOutput && !readOnlyFiles.count(file.first)) f << "\tclose(" << file.first << "_fd);\n";
 	}
 }
 
 // Function to drive helper functions to compile to target language
 void Writer::write() {
+	// Table-driven programs interpret a table file instead of compiling the machine in
+	if (options->tableDriven) {
+		writeTables();
+		writeTableProgram();
+		return;
+	}
+
 	writeIncludes();
 	declareStates();
+	writeRuntime();
 	writeLogic();
 }
\ No newline at end of file
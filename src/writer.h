@@ -6,8 +6,25 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <algorithm>
+#include <cstdio>
 #include "compiler.h"
 #include "action.h"
+#include "options.h"
+#include "runtime.h"
+#include "nfa.h"
+#include "bytemachine.h"
+#include "profile.h"
+#include "corpus.h"
+
+// Table file header
+#define TABLE_MAGIC "STATETAB"
+#define TABLE_VERSION 1
+#define TABLE_EXTENSION ".statetab"
+
+// Environment variable table-driven programs take their table path from, if set
+#define TABLE_ENV "STATE_TABLES"
 
 using namespace std;
 
@@ -19,19 +36,54 @@ private:
 	map<string, string>* inputs;				// Pointer to inputs parsed from source
 	map<string, map<string, string>>* states;	// Pointer to states parsed from source
 	map<string, vector<Action>>* outputActions;	// Pointer to output actions parsed from source
-	Action* inputAction;						// Pointer to input actions
+	vector<Action>* inputActions;				// Pointer to input actions, one per source
 	string firstState;							// Name of first state parsed
+	string summaryFormat;						// Format COUNT totals are emitted in
+	Nfa* nfa;									// Pointer to machine as written in source
+	Options* options;							// Pointer to command line options
+	vector<string> countedStates;				// States with COUNT actions, in counter index order
+	vector<string> nfaStates;					// NFA states in runtime index order; END is last
+	vector<vector<string>> symbols;				// Inputs grouped by symbol; symbol 0 is for unlisted inputs
+	string profilePath;							// Path compiled program writes its profile to
+	Profile profile;							// Profile used to order states and transitions
+	vector<string> stateOrder;					// DFA states in the order their code is laid out
+	bool usesIn;								// True if any action reads the current input
+	bool usesSrc;								// True if any action reads the source of the current input
+	bool multiplexed;							// True if inputs are read from several sources at once
+	set<string> readOnlyFiles;					// Files read by READ and never written by WRITE
+	string tablePath;							// Path table-driven programs load the machine from
+
+	static void splitMarkers(string, vector<string>&, vector<string>&);
 
 	void writeIncludes();
+	void buildAlphabet();
 	void declareAlphabet();
 	void declareStates();
 	void writeFileDeclarations();
+	void writeSourceDeclarations();
 	void writeLogic();
+	void writeTransitions();
+	void writeActions();
+	void declareNfaTables();
+	void writeLazyActions();
+	void declareByteTables();
+	void writeByteLogic();
+	string targetOf(string, string);
 	void writeInputAction();
+	string symbolExpression();
+	void writeTables();
+	void writeTableProgram();
 	void writeOutputAction(Action);
 	void writeFileCloses();
+	void writeRuntime();
+	void declareCounters();
+	void writeSummary();
+	int counterIndex(string);
+	void declareProfileCounters();
+	void writeProfiledTransitions(string, string, map<string, vector<int>>&);
+	unsigned long long symbolHits(string, int);
 public:
-	Writer(string, map<string, string>*, map<string, string>*, map<string, map<string, string>>*, map<string, vector<Action>>*, Action*, string);
+	Writer(string, map<string, string>*, map<string, string>*, map<string, map<string, string>>*, map<string, vector<Action>>*, vector<Action>*, string, string, Nfa*, Options*);
 	~Writer();
 
 	void write();
@@ -0,0 +1,45 @@
+#!/bin/sh
+# Compile-and-run checks for statec. Every directory in tests/ is one case holding a machine.statelang, which is
+# compiled with the options listed in its flags file (if any) and built. The program is then run on the case's
+# input file, or through the case's run script when it has one, and its output must match the expected file.
+# Run scripts are started in a scratch copy of the case with STATEC and CXX set.
+#
+# Usage: tests/run.sh [case...]
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+CXX=${CXX:-g++}
+STATEC="$work/statec"
+export CXX STATEC
+
+if ! $CXX -std=c++17 -O1 -pthread -o "$STATEC" "$root"/src/*.cpp; then
+	echo "FAIL building statec"
+	exit 1
+fi
+
+if [ $# -gt 0 ]; then cases="$*"; else cases=$(cd "$root/tests" && ls -d */ | tr -d /); fi
+
+failed=0
+for name in $cases; do
+	dir="$work/$name"
+	cp -r "$root/tests/$name" "$dir"
+
+	(
+		cd "$dir" || exit 1
+		"$STATEC" machine.statelang $(cat flags 2>/dev/null) || exit 1
+		$CXX -std=c++17 -pthread -o machine machine.cpp || exit 1
+		if [ -f run ]; then sh ./run; else ./machine < input; fi
+	) > "$dir/actual" 2>&1
+
+	if cmp -s "$root/tests/$name/expected" "$dir/actual"; then
+		echo "PASS $name"
+	else
+		echo "FAIL $name"
+		diff "$root/tests/$name/expected" "$dir/actual"
+		failed=1
+	fi
+done
+
+exit $failed